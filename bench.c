@@ -0,0 +1,305 @@
+/*
+ * Benchmarks of the strong types operations.
+ *
+ * Every operation runs in blocks of BLOCK calls, the time of every block
+ * gives a latency sample (ns per call) for the percentiles.
+ * The output is CSV, one line per operation and category:
+ *
+ * variant,op,category,ops,ns_per_op,mops,p50_ns,p90_ns,p99_ns,digits,compiler
+ *
+ * Options:
+ *   --no-header   do not print the CSV header (for appending variants)
+ *   --quick       fewer samples, for a smoke run
+ *
+ * The variant is set at compilation time with -DBENCH_VARIANT=\"name\",
+ * see the bench target of the Makefile.
+ * With -DTYPE_PROFILE the histograms of the library go on stderr.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include "strongtypes.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+
+#ifndef BENCH_VARIANT
+#define BENCH_VARIANT "custom"
+#endif
+
+#ifndef TYPE_DECIMAL_DIGITS
+#define TYPE_DECIMAL_DIGITS 3
+#endif
+
+#define VALUES      1024    /* power of 2 */
+#define BLOCK       256
+#define SAMPLES     2000
+
+enum BenchTypes {
+    B_NOM,
+    B_INT,
+    B_DEC,
+    B_ALL_TYPES /* placeholder */
+};
+
+static const char *CATEGORY[B_ALL_TYPES] = {"NOMINAL", "INTEGER", "DECIMAL"};
+
+#ifdef TYPE_TIMESTAMP
+/* the usual implementation, a clock read per call */
+type_millisecs type_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (type_millisecs)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+#endif
+
+static TypeValue values[B_ALL_TYPES][VALUES];
+static TypeValue divisors[B_ALL_TYPES][VALUES];
+static type_value_store raws[VALUES];
+static double reals[VALUES];
+static char texts[B_ALL_TYPES][VALUES][TYPE_STR_LEN];
+static volatile long long sink;
+
+/* a single call of the operation on the i-th input */
+typedef void (*bench_op)(int type, int i);
+
+static
+void op_seti(int type, int i)
+{
+    sink += type_seti(values[type][i], raws[i]).out.value;
+}
+
+static
+void op_setd(int type, int i)
+{
+    sink += type_setd(values[type][i], reals[i]).out.value;
+}
+
+static
+void op_setds(int type, int i)
+{
+    sink += type_setds(values[type][i], raws[i] * 1234).out.value;
+}
+
+static
+void op_setn(int type, int i)
+{
+    sink += type_setn(values[type][i], i & 3).out.value;
+}
+
+static
+void op_sum(int type, int i)
+{
+    sink += type_sum(values[type][i], values[type][VALUES - 1 - i]).out.value;
+}
+
+static
+void op_mul(int type, int i)
+{
+    sink += type_mul(values[type][i], values[type][VALUES - 1 - i]).out.value;
+}
+
+static
+void op_div(int type, int i)
+{
+    sink += type_div(values[type][i], divisors[type][i]).out.value;
+}
+
+static
+void op_fma(int type, int i)
+{
+    sink += type_fma(values[type][i], values[type][VALUES - 1 - i],
+                     values[type][i ^ 1]).out.value;
+}
+
+static struct TypeScale milli; /* B_INT to B_DEC, 1/1000 */
+
+static
+void op_convert(int type, int i)
+{
+    sink += type_convert(&milli, values[type][i]).out.value;
+}
+
+/* the same conversion through the floating point */
+static
+void op_convert_float(int type, int i)
+{
+    sink += type_setd(values[B_DEC][0],
+                      type_float(values[type][i]) / 1000.0).out.value;
+}
+
+static TypeRing *ring;
+
+/* a value through the ring, one push and one pop */
+static
+void op_ring(int type, int i)
+{
+    TypeValue out;
+    type_ring_push_n(ring, &values[type][i], 1);
+    type_ring_pop_n(ring, &out, 1);
+    sink += out.value;
+}
+
+static
+void op_str(int type, int i)
+{
+    char buf[TYPE_STR_LEN];
+    type_str(buf, values[type][i]);
+    sink += buf[0];
+}
+
+static
+void op_parse(int type, int i)
+{
+    const char *text = texts[type][i];
+    sink += type_parse(values[type][i], text, strlen(text)).out.value;
+}
+
+static
+void op_float(int type, int i)
+{
+    sink += (long long)type_float(values[type][i]);
+}
+
+static
+double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+static
+int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static
+void run(const char *name, bench_op op, int type, int samples)
+{
+    static double lat[SAMPLES];
+    double total = 0.0;
+    int k = 0;
+
+    /* warm up */
+    for (int i=0; i < VALUES; i++){
+        op(type, i);
+    }
+
+    for (int s=0; s < samples; s++){
+        double start = now_ns();
+        for (int j=0; j < BLOCK; j++){
+            op(type, k);
+            k = (k + 1) & (VALUES - 1);
+        }
+        double elapsed = now_ns() - start;
+
+        lat[s] = elapsed / BLOCK;
+        total += elapsed;
+    }
+
+    qsort(lat, samples, sizeof(double), cmp_double);
+
+    long long ops = (long long)samples * BLOCK;
+    double nsop = total / (double)ops;
+
+    printf("%s,%s,%s,%lld,%.3f,%.3f,%.3f,%.3f,%.3f,%i,\"%s\"\n",
+           BENCH_VARIANT, name, CATEGORY[type], ops,
+           nsop, 1e3 / nsop,
+           lat[samples / 2], lat[samples * 9 / 10], lat[samples * 99 / 100],
+           TYPE_DECIMAL_DIGITS, __VERSION__);
+}/* run */
+
+static
+void init_values(void)
+{
+    static struct TypeConf conf[B_ALL_TYPES];
+
+    conf[B_NOM] = type_conf_nom(4);
+    conf[B_INT] = type_conf_int(-1000000, 1000000);
+    conf[B_DEC] = type_conf_dec(type_dec(-1000000.0), type_dec(1000000.0), 2);
+    type_config(conf, B_ALL_TYPES);
+
+    milli = type_scale(B_INT, B_DEC, 1, 1000);
+
+    static char ringMem[4096];
+    assert(type_ring_size(64) <= sizeof(ringMem));
+    ring = type_ring(ringMem, 64, TYPE_RING_SPSC);
+
+    srand(42);
+    for (int i=0; i < VALUES; i++){
+        int r = rand() % 2000 - 1000;
+
+        raws[i] = r;
+        reals[i] = r / 7.0;
+
+        values[B_NOM][i] = type_setn(type_init(B_NOM), i & 3).out;
+        values[B_INT][i] = type_seti(type_init(B_INT), r).out;
+        values[B_DEC][i] = type_setd(type_init(B_DEC), reals[i]).out;
+
+        divisors[B_NOM][i] = values[B_NOM][i];
+        divisors[B_INT][i] = type_seti(type_init(B_INT), (r | 1)).out;
+        divisors[B_DEC][i] = type_setd(type_init(B_DEC), (r | 1) / 3.0).out;
+
+        for (int t=0; t < B_ALL_TYPES; t++){
+            type_str(texts[t][i], values[t][i]);
+        }
+    }
+}/* init_values */
+
+int main(int argc, char *argv[])
+{
+    int header = 1;
+    int samples = SAMPLES;
+
+    for (int i=1; i < argc; i++){
+        if (strcmp(argv[i], "--no-header") == 0){
+            header = 0;
+        } else if (strcmp(argv[i], "--quick") == 0){
+            samples = SAMPLES / 20;
+        } else {
+            fprintf(stderr, "Usage: %s [--no-header] [--quick]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    init_values();
+
+    if (header){
+        printf("variant,op,category,ops,ns_per_op,mops,"
+               "p50_ns,p90_ns,p99_ns,digits,compiler\n");
+    }
+
+    run("seti", op_seti, B_INT, samples);
+    run("setd", op_setd, B_DEC, samples);
+    run("setds", op_setds, B_DEC, samples);
+    run("setn", op_setn, B_NOM, samples);
+
+    for (int t=0; t < B_ALL_TYPES; t++){
+        run("sum", op_sum, t, samples);
+        run("mul", op_mul, t, samples);
+        run("div", op_div, t, samples);
+        run("fma", op_fma, t, samples);
+        run("str", op_str, t, samples);
+        run("parse", op_parse, t, samples);
+    }
+
+    run("float", op_float, B_DEC, samples);
+    run("convert", op_convert, B_INT, samples);
+    run("convert_float", op_convert_float, B_INT, samples);
+    run("ring", op_ring, B_INT, samples);
+
+#ifdef TYPE_PROFILE
+    static struct TypeProfile prof;
+    type_profile(&prof);
+    type_profile_dump(stderr, &prof);
+#endif
+
+    return 0;
+}
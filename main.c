@@ -1,9 +1,14 @@
 #include "strongtypes.h"
+#include "strongtypes_file.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <limits.h>
 #include <assert.h>
 #include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
 
 enum PrjTypes {
     HUGE,
@@ -12,6 +17,7 @@ enum PrjTypes {
     COEF,
     STATE,
     KHZ,
+    WIDE,
     ALL_TYPES /* placeholder */
 }; /* PrjTypes */
 
@@ -23,10 +29,12 @@ enum States {
 
 
 static type_millisecs timeMock = 0;
+static int timeCalls = 0;
 
 /* Implementation for timestamp management */
 type_millisecs type_now(void)
 {
+    timeCalls++;
     return timeMock;
 }
 
@@ -40,6 +48,7 @@ void init_typeconf()
     TYPE_CONFIG[COEF] = type_conf_dec(type_dec(-3.2), type_dec(3.2), 2);
     TYPE_CONFIG[STATE] = type_conf_nom(ALL_STATES);
     TYPE_CONFIG[KHZ] = type_conf_dec(type_dec(-65536.0), type_dec(65536.0),3);
+    TYPE_CONFIG[WIDE] = type_conf_dec(LLONG_MIN, LLONG_MAX, 3);
 }
 
 void test_level()
@@ -239,6 +248,8 @@ void test_khz()
 void test_str()
 {
     printf("test_str: ");
+
+    int count;
     char buf[TYPE_STR_LEN];
 
     TypeValue in = type_init(HUGE);
@@ -262,6 +273,55 @@ void test_str()
     type_str(buf, de); /* precision = 3 */
     assert(strncmp("61234.000", buf, TYPE_STR_LEN) == 0);
 
+    /* negative values keep the sign in front */
+    type_str(buf, type_setd(de, -0.5).out);
+    assert(strncmp("-0.500", buf, TYPE_STR_LEN) == 0);
+
+    type_str(buf, type_setd(type_init(COEF), -2.05).out); /* precision = 2 */
+    assert(strncmp("-2.05", buf, TYPE_STR_LEN) == 0);
+
+    type_str(buf, type_seti(in, LLONG_MIN).out);
+    assert(strncmp("-9223372036854775808", buf, TYPE_STR_LEN) == 0);
+
+    TypeValue wi = {.type = WIDE, .value = LLONG_MAX};
+    type_str(buf, wi);
+    assert(strncmp("9223372036854775.807", buf, TYPE_STR_LEN) == 0);
+
+    /* same output of printf */
+    char ref[TYPE_STR_LEN];
+    unsigned long long x = 1;
+    for (int i=0; i < 64; i++){
+        x = x * 3 + i;
+        in.value = (long long)(x >> 1);
+        in.value = (i % 2) ? in.value : -in.value;
+        type_str(buf, in);
+        snprintf(ref, sizeof(ref), "%lli", in.value);
+        assert(strcmp(ref, buf) == 0);
+
+        de.value = (long long)(x % 65536000); /* positive, as printf */
+        type_str(buf, de);
+        snprintf(ref, sizeof(ref), "%lli.%03lli", de.value / 1000, de.value % 1000);
+        assert(strcmp(ref, buf) == 0);
+    }
+
+    /* batch */
+    char line[64];
+    TypeValue vs[3] = {type_seti(in, -12).out, no, type_setd(de, 1.5).out};
+
+    count = type_str_n(line, sizeof(line), vs, 3, ';');
+    assert(count == 11);
+    assert(strcmp("-12;1;1.500", line) == 0);
+
+    /* the values are never cut */
+    count = type_str_n(line, 11, vs, 3, ';');
+    assert(count == -1);
+    assert(strcmp("-12;1", line) == 0);
+
+    count = type_str_n(line, sizeof(line), vs, 0, ';');
+    assert(count == 0);
+    assert(line[0] == '\0');
+
+    (void)count;
     printf("OK\n");
 }
 
@@ -336,6 +396,2252 @@ void test_timestamp(void)
     printf("OK\n");
 }
 
+void test_batch(void)
+{
+    printf("test_batch: ");
+
+    int count;
+    TypeResult rc;
+    enum TypeStatus st[4];
+    TypeValue a[4];
+    TypeValue b[4];
+    TypeValue out[4];
+
+    for (int i=0; i < 4; i++){
+        a[i] = type_seti(type_init(LEVEL), 500 - i * 250).out;
+        b[i] = type_seti(type_init(LEVEL), 500).out;
+    }
+    b[3] = type_setd(type_init(COEF), 1.0).out; /* different type */
+
+    /* 1000, 750, 500, incompatible */
+    count = type_sum_n(out, st, a, b, 4);
+    assert(count == 1);
+    assert(st[0] == TS_OK && type_int(out[0]) == 1000);
+    assert(st[1] == TS_OK && type_int(out[1]) == 750);
+    assert(st[2] == TS_OK && type_int(out[2]) == 500);
+    assert(st[3] == TS_INCOMPATIBLE);
+
+    /* the batch gives the same results of the single operation */
+    count = type_mul_n(out, st, a, b, 3);
+    assert(count == 2);
+    assert(st[0] == TS_OUTRANGE);
+    assert(st[1] == TS_OUTRANGE);
+    assert(st[2] == TS_OK && type_int(out[2]) == 0);
+    for (int i=0; i < 3; i++){
+        rc = type_mul(a[i], b[i]);
+        assert(rc.status == st[i]);
+        assert(rc.out.value == out[i].value);
+    }
+
+    /* in place, division by zero */
+    count = type_div_n(b, st, b, a, 3);
+    assert(count == 1);
+    assert(st[0] == TS_OK && type_int(b[0]) == 1);
+    assert(st[1] == TS_OK && type_int(b[1]) == 2);
+    assert(st[2] == TS_OUTRANGE);
+
+    /* decimals */
+    TypeValue da[2] = {type_setd(type_init(KHZ), 6.8).out,
+                       type_setd(type_init(KHZ), -3.2).out};
+    TypeValue db[2] = {da[1], da[0]};
+    count = type_div_n(out, st, da, db, 2);
+    assert(count == 0);
+    assert(type_float(out[0]) == -2.125);
+    rc = type_div(da[1], da[0]);
+    assert(out[1].value == rc.out.value);
+
+    /* the quotient is checked on the range */
+    TypeValue ha[2] = {type_seti(type_init(HUGE), LONG_MIN).out,
+                       type_seti(type_init(HUGE), -1).out};
+    TypeValue hb[2] = {ha[1], ha[1]};
+    count = type_div_n(out, st, ha, hb, 2);
+    assert(count == 1);
+    assert(st[0] == TS_OUTRANGE);
+    assert(st[1] == TS_OK && type_int(out[1]) == 1);
+
+    rc = type_div(type_seti(type_init(LEVEL), 1000).out,
+                  type_seti(type_init(LEVEL), -1).out);
+    assert(rc.status == TS_OUTRANGE);
+
+    /* nominal */
+    TypeValue na[2] = {type_setn(type_init(STATE), ON).out,
+                       type_setn(type_init(STATE), OFF).out};
+    count = type_sum_n(out, st, na, na, 2);
+    assert(count == 2);
+    assert(st[0] == TS_INCOMPATIBLE && st[1] == TS_INCOMPATIBLE);
+
+    count = type_sum_n(out, st, a, b, 0);
+    assert(count == 0);
+
+    (void)count;
+    (void)rc;
+    printf("OK\n");
+}/* test_batch */
+
+void test_column(void)
+{
+    printf("test_column: ");
+
+    enum TypeStatus ts;
+    int count;
+
+    enum TypeStatus st[4];
+    static char mema[1024];
+    static char memb[1024];
+
+    assert(type_column_size(4) <= sizeof(mema));
+
+    TypeColumn a = type_column(LEVEL, mema, 4);
+    TypeColumn b = type_column(LEVEL, memb, 4);
+
+    assert(((size_t)a.values % TYPE_COLUMN_ALIGN) == 0);
+    assert(((size_t)a.timestamps % TYPE_COLUMN_ALIGN) == 0);
+    assert(type_int(type_column_get(&a, 3)) == 0);
+
+    timeMock = 400;
+
+    const type_value_store va[4] = {500, 1000, -1000, 10};
+    count = type_column_set(&a, st, va);
+    assert(count == 1);
+    assert(st[2] == TS_OUTRANGE);
+    assert(type_int(type_column_get(&a, 1)) == 1000);
+    assert(type_int(type_column_get(&a, 2)) == 0); /* unchanged */
+    assert(type_get_time(type_column_get(&a, 1)) == 400);
+    assert(type_get_time(type_column_get(&a, 2)) == 0);
+
+    TypeValue lev = type_seti(type_init(LEVEL), -5).out;
+    ts = type_column_put(&b, 0, lev);
+    assert(ts == TS_OK);
+    ts = type_column_put(&b, 1, type_init(POWER));
+    assert(ts == TS_INCOMPATIBLE);
+    const type_value_store vb[4] = {-5, 1, 20, 3};
+    count = type_column_set(&b, st, vb);
+    assert(count == 0);
+
+    /* same results of the single value operations */
+    TypeColumn out = a;
+    count = type_column_sum(&out, st, &a, &b);
+    assert(count == 1);
+    assert(st[0] == TS_OK && st[1] == TS_OUTRANGE);
+    assert(type_int(type_column_get(&a, 0)) == 495);
+    assert(type_int(type_column_get(&a, 1)) == 1000); /* unchanged */
+    assert(type_int(type_column_get(&a, 3)) == 13);
+
+    count = type_column_mul(&out, st, &a, &b);
+    assert(count == 1);
+    assert(st[0] == TS_OUTRANGE && st[1] == TS_OK && st[2] == TS_OK);
+    assert(type_int(type_column_get(&a, 2)) == 400);
+    assert(type_int(type_column_get(&a, 3)) == 39);
+
+    ts = type_column_put(&b, 1, type_init(LEVEL));
+    assert(ts == TS_OK);
+    count = type_column_div(&out, st, &a, &b);
+    assert(count == 1);
+    assert(st[1] == TS_OUTRANGE); /* division by zero */
+    assert(type_int(type_column_get(&a, 0)) == -99);
+    assert(type_int(type_column_get(&a, 2)) == 20);
+
+    TypeColumn p = type_column(POWER, memb, 4);
+    count = type_column_sum(&out, st, &a, &p);
+    assert(count == 4);
+    assert(st[0] == TS_INCOMPATIBLE);
+
+    /* decimals are truncated to the precision */
+    TypeColumn k = type_column(COEF, memb, 4);
+    const type_value_store vk[4] = {type_dec(3.1477), type_dec(-3.2),
+                                   type_dec(3.3), 1};
+    count = type_column_set(&k, st, vk);
+    assert(count == 1);
+    assert(type_float(type_column_get(&k, 0)) == 3.14);
+    assert(type_int(type_column_get(&k, 3)) == 0);
+
+    count = type_column_validate(&k, NULL);
+    assert(count == 0);
+    k.values[1] = type_dec(-4.0); /* corrupted from outside */
+    count = type_column_validate(&k, NULL);
+    assert(count == 1);
+    count = type_column_validate(&k, st);
+    assert(count == 1);
+    assert(st[0] == TS_OK && st[1] == TS_OUTRANGE);
+
+    (void)ts;
+    (void)count;
+    printf("OK\n");
+}/* test_column */
+
+static bool simdStop = false;
+
+/* switch the level while the other thread runs the kernels */
+static
+void *simd_switcher(void *arg)
+{
+    (void)arg;
+    for (int i=0; !__atomic_load_n(&simdStop, __ATOMIC_ACQUIRE); i++){
+        type_simd_set((enum TypeSimd)(i % (TYPE_SIMD_AVX512 + 1)));
+        sched_yield();
+    }
+    return NULL;
+}/* simd_switcher */
+
+/* all the vector levels must give the same results of type_sum */
+void test_simd(void)
+{
+    printf("test_simd: ");
+
+    int count;
+    int failed;
+    enum { N = 37 }; /* not a multiple of the lanes */
+    enum TypeStatus st[N];
+    enum TypeStatus sat[N];
+    static char mema[4096];
+    static char memb[4096];
+    static char memo[4096];
+    const enum TypeSimd best = type_simd();
+
+    TypeColumn a = type_column(HUGE, mema, N);
+    TypeColumn b = type_column(HUGE, memb, N);
+    TypeColumn out = type_column(HUGE, memo, N);
+
+    for (int i=0; i < N; i++){
+        a.values[i] = (i % 3 == 0) ? LLONG_MAX - i : (i - 18) * 1000003LL;
+        b.values[i] = (i % 5 == 0) ? LLONG_MIN + i : (i % 4) * 7LL;
+    }
+    a.values[1] = LLONG_MIN;
+    b.values[1] = -1;
+
+    for (int level=TYPE_SIMD_SCALAR; level <= TYPE_SIMD_AVX512; level++){
+        type_simd_set(level);
+
+        for (int i=0; i < N; i++){
+            out.values[i] = -42;
+        }
+        failed = type_column_sum(&out, st, &a, &b);
+
+        int expected = 0;
+        for (int i=0; i < N; i++){
+            TypeResult rc = type_sum(type_column_get(&a, i),
+                                     type_column_get(&b, i));
+            expected += (rc.status != TS_OK);
+            assert(rc.status == st[i]);
+            assert(out.values[i] == (rc.status == TS_OK ? rc.out.value : -42));
+        }
+        assert(failed == expected);
+        assert(failed > 0);
+
+        /* LEVEL range on the same data */
+        a.type = LEVEL;
+        b.type = LEVEL;
+        out.type = LEVEL;
+
+        count = type_column_validate(&a, st);
+        assert(count == type_column_validate(&a, NULL));
+        for (int i=0; i < N; i++){
+            assert(st[i] == ((a.values[i] >= -999 && a.values[i] <= 1000) ?
+                             TS_OK : TS_OUTRANGE));
+        }
+
+        int saturated = type_column_sum_sat(&out, sat, &a, &b);
+        for (int i=0; i < N; i++){
+            TypeValue va = {.type = HUGE, .value = a.values[i]};
+            TypeValue vb = {.type = HUGE, .value = b.values[i]};
+            TypeResult rc = type_sum(va, vb);
+            type_value_store v = rc.out.value;
+            if (rc.status != TS_OK){
+                v = (b.values[i] > 0) ? 1000 : -999;
+            }
+            v = v < -999 ? -999 : (v > 1000 ? 1000 : v);
+            assert(out.values[i] == v);
+            saturated -= (sat[i] == TS_OUTRANGE);
+        }
+        assert(saturated == 0);
+
+        /* clamp */
+        for (int i=0; i < N; i++){
+            out.values[i] = a.values[i];
+        }
+        count = type_column_clamp(&out, NULL);
+        assert(count == type_column_validate(&a, NULL));
+        count = type_column_validate(&out, NULL);
+        assert(count == 0);
+
+        a.type = HUGE;
+        b.type = HUGE;
+        out.type = HUGE;
+    }
+
+    /* the same results while the level changes */
+    type_simd_set(TYPE_SIMD_SCALAR);
+    int expected = type_column_sum(&out, st, &a, &b);
+    type_value_store ref[N];
+    memcpy(ref, out.values, sizeof(ref));
+
+    pthread_t th;
+    int rc = pthread_create(&th, NULL, simd_switcher, NULL);
+    assert(rc == 0);
+    for (int k=0; k < 2000; k++){
+        failed = type_column_sum(&out, sat, &a, &b);
+        assert(failed == expected);
+        assert(memcmp(st, sat, sizeof(st)) == 0);
+        assert(memcmp(ref, out.values, sizeof(ref)) == 0);
+        if (k % 100 == 0){
+            sched_yield();
+        }
+    }
+    __atomic_store_n(&simdStop, true, __ATOMIC_RELEASE);
+    rc = pthread_join(th, NULL);
+    assert(rc == 0);
+
+    /* a configuration keeps the level */
+    type_simd_set(TYPE_SIMD_SCALAR);
+    type_config(TYPE_CONFIG, ALL_TYPES);
+    assert(type_simd() == TYPE_SIMD_SCALAR);
+
+    const enum TypeSimd back = type_simd_set(best);
+    assert(back == best);
+
+    (void)expected;
+    (void)count;
+    (void)failed;
+    (void)back;
+    (void)rc;
+    printf("OK\n");
+}/* test_simd */
+
+void test_config(void)
+{
+    printf("test_config: ");
+
+    struct TypeConf table[ALL_TYPES];
+    memcpy(table, TYPE_CONFIG, sizeof(table));
+    table[COEF] = type_conf_dec(type_dec(-9.0), type_dec(9.0), 1);
+
+    /* the table is copied */
+    type_config(table, ALL_TYPES);
+    memset(table, 0, sizeof(table));
+
+    TypeResult rc = type_setd(type_init(COEF), -8.76);
+    assert(rc.status == TS_OK);
+    assert(type_float(rc.out) == -8.7);
+
+    rc = type_setd(type_init(COEF), 0.09);
+    assert(rc.status == TS_OK);
+    assert(rc.out.value == 0);
+
+    rc = type_seti(type_init(HUGE), LLONG_MIN);
+    assert(rc.status == TS_OK);
+
+    /* restore */
+    type_config(TYPE_CONFIG, ALL_TYPES);
+
+    rc = type_setd(type_init(COEF), -3.1477);
+    assert(rc.status == TS_OK);
+    assert(type_float(rc.out) == -3.14);
+
+    (void)rc;
+    printf("OK\n");
+}/* test_config */
+
+/* decimal operations with intermediate results beyond 64 bits */
+void test_wide(void)
+{
+    printf("test_wide: ");
+
+    TypeResult rc;
+    TypeValue a = type_init(WIDE);
+    TypeValue b = type_init(WIDE);
+
+    /* 3e9 * 4000, the product of the stores overflows */
+    a = type_seti(type_init(HUGE), 3000000000LL).out;
+    a.type = WIDE;
+    a.value *= 1000;
+    b = type_setd(b, 4000.0).out;
+
+    rc = type_mul(a, b);
+    assert(rc.status == TS_OK);
+    assert(rc.out.value == 12000000000000LL * 1000);
+
+    rc = type_mul(a, type_setd(b, -4000.5).out);
+    assert(rc.status == TS_OK);
+    assert(rc.out.value == -12001500000000LL * 1000);
+
+    /* the result does not fit */
+    rc = type_mul(a, a);
+    assert(rc.status == TS_OUTRANGE);
+
+    /* 1e13 / 4000, the scaled dividend overflows */
+    a.value = 10000000000000LL * 1000;
+    rc = type_div(a, b);
+    assert(rc.status == TS_OK);
+    assert(rc.out.value == 2500000000LL * 1000);
+
+    /* 1e13 / 3 is exact to the last digit */
+    rc = type_div(a, type_setd(b, 3.0).out);
+    assert(rc.status == TS_OK);
+    assert(rc.out.value == 3333333333333333LL);
+
+    rc = type_div(a, type_setd(b, -0.001).out);
+    assert(rc.status == TS_OUTRANGE);
+
+    /* KHZ, exact division */
+    a = type_setd(type_init(KHZ), 1.0).out;
+    b = type_setd(type_init(KHZ), 3.0).out;
+    rc = type_div(a, b);
+    assert(rc.status == TS_OK);
+    assert(rc.out.value == 333);
+
+    rc = type_div(b, type_setd(b, -3.0).out);
+    assert(rc.status == TS_OK);
+    assert(rc.out.value == -1000);
+
+    (void)rc;
+    printf("OK\n");
+}/* test_wide */
+
+void test_parse(void)
+{
+    printf("test_parse: ");
+
+    int count;
+
+    TypeResult rc;
+    TypeValue lev = type_init(LEVEL);
+    TypeValue coef = type_init(COEF);
+    TypeValue khz = type_init(KHZ);
+
+    rc = type_parse(lev, "-999", 4);
+    assert(rc.status == TS_OK && type_int(rc.out) == -999);
+
+    rc = type_parse(lev, "+1000xyz", 5); /* len */
+    assert(rc.status == TS_OK && type_int(rc.out) == 1000);
+
+    rc = type_parse(lev, "1001", 4);
+    assert(rc.status == TS_OUTRANGE);
+    rc = type_parse(lev, "1.5", 3);
+    assert(rc.status == TS_INCOMPATIBLE);
+    rc = type_parse(lev, "", 0);
+    assert(rc.status == TS_INCOMPATIBLE);
+    rc = type_parse(lev, "-", 1);
+    assert(rc.status == TS_INCOMPATIBLE);
+    rc = type_parse(lev, " 1", 2);
+    assert(rc.status == TS_INCOMPATIBLE);
+
+    rc = type_parse(type_init(HUGE), "-9223372036854775808", 20);
+    assert(rc.status == TS_OK && type_int(rc.out) == LLONG_MIN);
+    rc = type_parse(type_init(HUGE), "9223372036854775808", 19);
+    assert(rc.status == TS_OUTRANGE);
+
+    rc = type_parse(type_init(STATE), "1", 1);
+    assert(rc.status == TS_OK && type_nom(rc.out) == OFF);
+
+    /* decimals, truncated to the precision */
+    rc = type_parse(coef, "3.1477", 6);
+    assert(rc.status == TS_OK && rc.out.value == 3140);
+
+    rc = type_parse(coef, "-0.099", 6);
+    assert(rc.status == TS_OK && rc.out.value == -90);
+
+    rc = type_parse(coef, "-3.2", 4);
+    assert(rc.status == TS_OK && rc.out.value == -3200);
+
+    rc = type_parse(coef, "3.21", 4);
+    assert(rc.status == TS_OUTRANGE);
+    rc = type_parse(coef, "3.2.1", 5);
+    assert(rc.status == TS_INCOMPATIBLE);
+    rc = type_parse(coef, ".", 1);
+    assert(rc.status == TS_INCOMPATIBLE);
+
+    rc = type_parse(coef, ".5", 2);
+    assert(rc.status == TS_OK && rc.out.value == 500);
+
+    rc = type_parse(khz, "61234.32", 8); /* exact, no binary rounding */
+    assert(rc.status == TS_OK && rc.out.value == 61234320);
+
+    rc = type_parse(khz, "2", 1);
+    assert(rc.status == TS_OK && rc.out.value == 2000);
+
+    /* bulk */
+    const char *csv = "1.5; -2 ;x\t;0.0019;99999\n";
+    TypeValue out[8];
+    enum TypeStatus st[8];
+
+    count = type_parse_n(out, st, KHZ, csv, strlen(csv), ';', 8);
+    assert(count == 5);
+    assert(st[0] == TS_OK && out[0].value == 1500);
+    assert(st[1] == TS_OK && out[1].value == -2000);
+    assert(st[2] == TS_INCOMPATIBLE);
+    assert(st[3] == TS_OK && out[3].value == 1);
+    assert(st[4] == TS_OUTRANGE);
+
+    count = type_parse_n(out, st, KHZ, csv, strlen(csv), ';', 2);
+    assert(count == 2);
+
+    static char mem[1024];
+    TypeColumn col = type_column(LEVEL, mem, 4);
+    const char *lines = "10\n20\r\n2000\n-40\n50\n";
+
+    count = type_column_parse(&col, st, lines, strlen(lines), '\n');
+    assert(count == 4);
+    assert(st[2] == TS_OUTRANGE);
+    assert(col.values[0] == 10 && col.values[1] == 20);
+    assert(col.values[2] == 0 && col.values[3] == -40);
+
+    (void)count;
+    (void)rc;
+    printf("OK\n");
+}/* test_parse */
+
+void test_setdec(void)
+{
+    printf("test_setdec: ");
+
+    TypeResult rc;
+    TypeValue coef = type_init(COEF);
+
+    rc = type_setds(coef, 3149);
+    assert(rc.status == TS_OK && rc.out.value == 3140);
+
+    rc = type_setds(coef, -3211);
+    assert(rc.status == TS_OUTRANGE);
+
+    rc = type_setds(type_init(LEVEL), 10);
+    assert(rc.status == TS_INCOMPATIBLE);
+
+    /* 3.14 from different representations */
+    rc = type_setdec(coef, 314, -2);
+    assert(rc.status == TS_OK && rc.out.value == 3140);
+    rc = type_setdec(coef, 314159265, -8);
+    assert(rc.status == TS_OK && rc.out.value == 3140);
+    rc = type_setdec(coef, -314, -2);
+    assert(rc.status == TS_OK && rc.out.value == -3140);
+
+    /* positive exponent */
+    rc = type_setdec(type_init(KHZ), 65, 3);
+    assert(rc.status == TS_OK && rc.out.value == 65000000);
+    rc = type_setdec(type_init(KHZ), 66, 3);
+    assert(rc.status == TS_OUTRANGE);
+
+    /* the scaled value does not fit */
+    rc = type_setdec(type_init(WIDE), 1, 16);
+    assert(rc.status == TS_OUTRANGE);
+    rc = type_setdec(type_init(WIDE), 1, 15);
+    assert(rc.status == TS_OK && rc.out.value == 1000000000000000000LL);
+    rc = type_setdec(type_init(WIDE), 0, 100);
+    assert(rc.status == TS_OK && rc.out.value == 0);
+    rc = type_setdec(type_init(WIDE), 1, INT_MAX);
+    assert(rc.status == TS_OUTRANGE);
+    rc = type_setdec(type_init(WIDE), 0, INT_MAX);
+    assert(rc.status == TS_OK && rc.out.value == 0);
+
+    /* too small */
+    rc = type_setdec(coef, 9, -4);
+    assert(rc.status == TS_OK && rc.out.value == 0);
+    rc = type_setdec(coef, LLONG_MAX, -100);
+    assert(rc.status == TS_OK && rc.out.value == 0);
+    rc = type_setdec(coef, LLONG_MAX, INT_MIN);
+    assert(rc.status == TS_OK && rc.out.value == 0);
+
+    (void)rc;
+    printf("OK\n");
+}/* test_setdec */
+
+void test_time_scope(void)
+{
+    printf("test_time_scope: ");
+
+    TypeResult rc;
+    TypeValue a = type_seti(type_init(LEVEL), 10).out;
+    TypeValue b[3] = {a, a, a};
+    TypeValue out[3];
+    enum TypeStatus st[3];
+
+    timeMock = 500;
+    type_time_begin();
+
+    /* the time is read just once */
+    timeCalls = 0;
+    timeMock = 600;
+
+    TypeValue c = type_sum(a, a).out;
+    TypeValue d = type_setd(type_init(KHZ), 1.5).out;
+    TypeValue e = type_parse(type_init(LEVEL), "5", 1).out;
+    type_sum_n(out, st, b, b, 3);
+
+    assert(timeCalls == 0);
+    assert(type_get_time(c) == 500);
+    assert(type_get_time(d) == 500);
+    assert(type_get_time(e) == 500);
+    assert(type_get_time(out[2]) == 500);
+
+    type_time_end();
+
+    rc = type_sum(a, a);
+    assert(type_get_time(rc.out) == 600);
+    assert(timeCalls == 1);
+
+    /* explicit time */
+    type_time_begin_at(42);
+    rc = type_mul(a, a);
+    assert(type_get_time(rc.out) == 42);
+    type_time_end();
+
+    (void)c;
+    (void)d;
+    (void)e;
+    (void)rc;
+    printf("OK\n");
+}/* test_time_scope */
+
+void test_context(void)
+{
+    printf("test_context: ");
+
+    struct TypeConf table[ALL_TYPES];
+    memcpy(table, TYPE_CONFIG, sizeof(table));
+    table[LEVEL] = type_conf_int(0, 5000);
+
+    TypeContext *ctx = type_context_new(table, ALL_TYPES);
+
+    /* the default context is used until a context is bound */
+    TypeResult rc = type_seti(type_init(LEVEL), 2000);
+    assert(rc.status == TS_OUTRANGE);
+
+    TypeContext *prev = type_context_use(ctx);
+    assert(prev == NULL);
+
+    rc = type_seti(type_init(LEVEL), 2000);
+    assert(rc.status == TS_OK);
+    rc = type_sum(rc.out, rc.out);
+    assert(rc.status == TS_OK);
+
+    /* reconfigure only the bound context */
+    table[LEVEL] = type_conf_int(0, 10);
+    type_context_config(ctx, table, ALL_TYPES);
+    rc = type_seti(type_init(LEVEL), 50);
+    assert(rc.status == TS_OUTRANGE);
+
+    TypeContext *bound = type_context_use(prev);
+    assert(bound == ctx);
+    rc = type_seti(type_init(LEVEL), 50);
+    assert(rc.status == TS_OK);
+
+    type_context_free(ctx);
+
+    (void)rc;
+    (void)bound;
+    printf("OK\n");
+}/* test_context */
+
+static bool workersStop = false;
+
+/* sum in loop while the configuration changes */
+static
+void *reconfig_worker(void *arg)
+{
+    (void)arg;
+
+    type_thread_online();
+    type_time_begin_at(0); /* no calls to the mock clock */
+
+    TypeValue a = type_seti(type_init(LEVEL), 400).out;
+
+    while (!__atomic_load_n(&workersStop, __ATOMIC_ACQUIRE)){
+        /* 800 is valid only with the table of TYPE_CONFIG */
+        TypeResult rc = type_sum(a, a);
+        assert(rc.status == TS_OK || rc.status == TS_OUTRANGE);
+        assert(rc.status != TS_OK || rc.out.value == 800);
+        (void)rc;
+
+        type_quiescent();
+    }
+
+    type_time_end();
+    type_thread_offline();
+    return NULL;
+}/* reconfig_worker */
+
+void test_reconfig(void)
+{
+    printf("test_reconfig: ");
+
+    struct TypeConf table[ALL_TYPES];
+    memcpy(table, TYPE_CONFIG, sizeof(table));
+    table[LEVEL] = type_conf_int(0, 500);
+
+    /* nobody online, no wait */
+    type_synchronize();
+
+    enum {WORKERS = 3};
+    pthread_t workers[WORKERS];
+    int rc;
+
+    for (int i=0; i < WORKERS; i++){
+        rc = pthread_create(&workers[i], NULL, reconfig_worker, NULL);
+        assert(rc == 0);
+    }
+
+    /* the writer can be online too */
+    type_thread_online();
+
+    for (int i=0; i < 200; i++){
+        type_config((i % 2 == 0) ? table : TYPE_CONFIG, ALL_TYPES);
+        type_quiescent();
+    }
+
+    type_thread_offline();
+
+    __atomic_store_n(&workersStop, true, __ATOMIC_RELEASE);
+    for (int i=0; i < WORKERS; i++){
+        rc = pthread_join(workers[i], NULL);
+        assert(rc == 0);
+    }
+
+    /* the last one restored TYPE_CONFIG */
+    TypeValue a = type_seti(type_init(LEVEL), 400).out;
+    TypeResult sum = type_sum(a, a);
+    assert(sum.status == TS_OK);
+
+    (void)rc;
+    (void)sum;
+    printf("OK\n");
+}/* test_reconfig */
+
+/* online writers, every one waits for the others */
+static
+void *reconfig_writer(void *arg)
+{
+    const struct TypeConf *table = arg;
+
+    type_thread_online();
+    for (int i=0; i < 100; i++){
+        type_config((i % 2 == 0) ? table : TYPE_CONFIG, ALL_TYPES);
+        type_quiescent();
+        sched_yield(); /* let the other writer in */
+        type_synchronize();
+    }
+    type_config(TYPE_CONFIG, ALL_TYPES);
+    type_thread_offline();
+
+    return NULL;
+}/* reconfig_writer */
+
+void test_reconfig_writers(void)
+{
+    printf("test_reconfig_writers: ");
+
+    struct TypeConf table[ALL_TYPES];
+    memcpy(table, TYPE_CONFIG, sizeof(table));
+    table[LEVEL] = type_conf_int(0, 500);
+
+    enum {WRITERS = 2};
+    pthread_t writers[WRITERS];
+    int rc;
+
+    for (int i=0; i < WRITERS; i++){
+        rc = pthread_create(&writers[i], NULL, reconfig_writer, table);
+        assert(rc == 0);
+    }
+
+    for (int i=0; i < WRITERS; i++){
+        rc = pthread_join(writers[i], NULL);
+        assert(rc == 0);
+    }
+
+    /* both restored TYPE_CONFIG at the end */
+    TypeValue a = type_seti(type_init(LEVEL), 400).out;
+    TypeResult res = type_sum(a, a);
+    assert(res.status == TS_OK);
+
+    (void)rc;
+    (void)res;
+    printf("OK\n");
+}/* test_reconfig_writers */
+
+void test_pack(void)
+{
+    printf("test_pack: ");
+
+    enum TypeStatus ts;
+    int count;
+    TypeResult rc;
+
+    assert(sizeof(type_packed) == 8);
+
+    assert(type_packable(LEVEL));
+    assert(type_packable(KHZ));
+    assert(type_packable(STATE));
+    assert(!type_packable(HUGE));
+    assert(!type_packable(WIDE));
+
+    type_packed p = 0;
+    TypeValue big = type_seti(type_init(HUGE), LONG_MAX).out;
+    ts = type_pack(&p, big);
+    assert(ts == TS_INCOMPATIBLE);
+    assert(p == 0);
+
+    /* round trip, the limits and the sign */
+    TypeValue v[4] = {type_seti(type_init(LEVEL), -999).out,
+                      type_seti(type_init(LEVEL), 1000).out,
+                      type_setd(type_init(KHZ), -65536.0).out,
+                      type_setd(type_init(COEF), -0.25).out};
+    type_packed pv[4];
+    TypeValue back[4];
+    enum TypeStatus st[4];
+
+    count = type_pack_n(pv, st, v, 4);
+    assert(count == 0);
+    type_unpack_n(back, pv, 4);
+    for (int i=0; i < 4; i++){
+        assert(st[i] == TS_OK);
+        assert(back[i].type == v[i].type);
+        assert(back[i].value == v[i].value);
+    }
+
+    /* same results of the unpacked operations */
+    TypeValue a = type_seti(type_init(LEVEL), 600).out;
+    TypeValue b = type_seti(type_init(LEVEL), -20).out;
+    type_packed pa, pb;
+    ts = type_pack(&pa, a);
+    assert(ts == TS_OK);
+    ts = type_pack(&pb, b);
+    assert(ts == TS_OK);
+
+    struct TypePackedResult pr = type_pack_sum(pa, pb);
+    assert(pr.status == TS_OK);
+    assert(type_int(type_unpack(pr.out)) == 580);
+
+    pr = type_pack_sum(pa, pa);
+    assert(pr.status == TS_OUTRANGE);
+
+    pr = type_pack_mul(pb, pb);
+    assert(pr.status == TS_OK && type_int(type_unpack(pr.out)) == 400);
+
+    pr = type_pack_div(pa, pb);
+    assert(pr.status == TS_OK && type_int(type_unpack(pr.out)) == -30);
+
+    TypeValue c = type_setd(type_init(COEF), 1.5).out;
+    TypeValue d = type_setd(type_init(COEF), -0.75).out;
+    type_packed pc, pd;
+    ts = type_pack(&pc, c);
+    assert(ts == TS_OK);
+    ts = type_pack(&pd, d);
+    assert(ts == TS_OK);
+
+    pr = type_pack_mul(pc, pd);
+    assert(pr.status == TS_OK);
+    rc = type_mul(c, d);
+    assert(type_unpack(pr.out).value == rc.out.value);
+
+    pr = type_pack_div(pc, pd);
+    assert(pr.status == TS_OK);
+    rc = type_div(c, d);
+    assert(type_unpack(pr.out).value == rc.out.value);
+
+    /* different types, nominal */
+    pr = type_pack_sum(pa, pc);
+    assert(pr.status == TS_INCOMPATIBLE);
+
+    type_packed on;
+    ts = type_pack(&on, type_setn(type_init(STATE), ON).out);
+    assert(ts == TS_OK);
+    pr = type_pack_sum(on, on);
+    assert(pr.status == TS_INCOMPATIBLE);
+
+    (void)ts;
+    (void)count;
+    (void)rc;
+    (void)pr;
+    printf("OK\n");
+}/* test_pack */
+
+void test_narrow(void)
+{
+    printf("test_narrow: ");
+
+    int width;
+    int n;
+    enum TypeStatus ts;
+    TypeResult rc;
+
+    width = type_width(POWER);
+    assert(width == 1);
+    width = type_width(LEVEL);
+    assert(width == 2);
+    width = type_width(COEF);
+    assert(width == 2);
+    width = type_width(KHZ);
+    assert(width == 4);
+    width = type_width(HUGE);
+    assert(width == 8);
+
+    enum {LEN = 5};
+    assert(type_narrow_size(POWER, 64) < type_column_size(64));
+
+    void *mema = malloc(type_narrow_size(POWER, LEN));
+    void *memb = malloc(type_narrow_size(POWER, LEN));
+    void *memo = malloc(type_narrow_size(POWER, LEN));
+    assert(mema != NULL && memb != NULL && memo != NULL);
+
+    TypeNarrow a = type_narrow(POWER, mema, LEN);
+    TypeNarrow b = type_narrow(POWER, memb, LEN);
+    TypeNarrow out = type_narrow(POWER, memo, LEN);
+    assert(a.width == 1);
+    assert(((uintptr_t)a.values % TYPE_COLUMN_ALIGN) == 0);
+
+    enum TypeStatus st[LEN];
+    type_value_store va[LEN] = {0, 100, 60, 101, 7};
+    type_value_store vb[LEN] = {0, 1, 50, 3, 93};
+
+    timeMock = 77;
+    n = type_narrow_set(&a, st, va);
+    assert(n == 1);
+    assert(st[3] == TS_OUTRANGE);
+    TypeValue tv = type_narrow_get(&a, 3);
+    assert(tv.value == 0);
+    tv = type_narrow_get(&a, 1);
+    assert(tv.value == 100);
+    assert(type_get_time(tv) == 77);
+    n = type_narrow_set(&b, st, vb);
+    assert(n == 0);
+
+    /* 0, 101, 110, 3, 100: widened, no wrap of the int8 lanes */
+    n = type_narrow_sum(&out, st, &a, &b);
+    assert(n == 2);
+    assert(st[1] == TS_OUTRANGE && st[2] == TS_OUTRANGE);
+    tv = type_narrow_get(&out, 1);
+    assert(tv.value == 0);
+    tv = type_narrow_get(&out, 4);
+    assert(tv.value == 100);
+    n = type_narrow_validate(&out, NULL);
+    assert(n == 0);
+
+    n = type_narrow_mul(&out, st, &a, &b);
+    assert(n == 2);
+    tv = type_narrow_get(&out, 0);
+    assert(type_int(tv) == 0);
+    assert(st[4] == TS_OUTRANGE);
+
+    /* division by zero */
+    n = type_narrow_div(&out, st, &b, &a);
+    assert(n == 2);
+    assert(st[0] == TS_OUTRANGE && st[3] == TS_OUTRANGE);
+    tv = type_narrow_get(&out, 4);
+    assert(type_int(tv) == 13);
+
+    /* values from outside are checked */
+    ((int8_t *)a.values)[2] = -5;
+    n = type_narrow_validate(&a, st);
+    assert(n == 1);
+    assert(st[2] == TS_OUTRANGE);
+
+    /* put and the type */
+    ts = type_narrow_put(&a, 2, type_seti(type_init(POWER), 42).out);
+    assert(ts == TS_OK);
+    tv = type_narrow_get(&a, 2);
+    assert(type_int(tv) == 42);
+    ts = type_narrow_put(&a, 2, type_seti(type_init(LEVEL), 1).out);
+    assert(ts == TS_INCOMPATIBLE);
+
+    /* decimals on 32 bits lanes */
+    void *memk = malloc(type_narrow_size(KHZ, LEN));
+    assert(memk != NULL);
+    TypeNarrow k = type_narrow(KHZ, memk, LEN);
+    type_value_store vk[LEN] = {type_dec(65000.0), type_dec(-65000.0),
+                                type_dec(1.5), type_dec(-2.25), 0};
+    n = type_narrow_set(&k, st, vk);
+    assert(n == 0);
+    n = type_narrow_sum(&k, st, &k, &k);
+    assert(n == 2);
+    tv = type_narrow_get(&k, 0);
+    assert(type_float(tv) == 65000.0);
+    tv = type_narrow_get(&k, 3);
+    assert(type_float(tv) == -4.5);
+    n = type_narrow_sum(&k, st, &k, &a); /* different types */
+    assert(n == LEN);
+
+    /* the quotient is checked on the range: -128 / -1 does not fit */
+    struct TypeConf other[ALL_TYPES];
+    memcpy(other, TYPE_CONFIG, sizeof(other));
+    other[POWER] = type_conf_int(-128, 127);
+    type_config(other, ALL_TYPES);
+
+    TypeNarrow q = type_narrow(POWER, mema, LEN);
+    TypeNarrow d = type_narrow(POWER, memb, LEN);
+    type_value_store vq[LEN] = {-128, -128, 127, -127, 10};
+    type_value_store vd[LEN] = {-1, 1, -1, -1, -3};
+    n = type_narrow_set(&q, st, vq);
+    assert(n == 0);
+    n = type_narrow_set(&d, st, vd);
+    assert(n == 0);
+    n = type_narrow_div(&q, st, &q, &d);
+    assert(n == 1 && st[0] == TS_OUTRANGE);
+    tv = type_narrow_get(&q, 0);
+    assert(tv.value == -128);
+    tv = type_narrow_get(&q, 2);
+    assert(tv.value == -127);
+    n = type_narrow_validate(&q, NULL);
+    assert(n == 0);
+
+    TypeValue ta = type_seti(type_init(POWER), -128).out;
+    TypeValue tb = type_seti(type_init(POWER), -1).out;
+    rc = type_div(ta, tb);
+    assert(rc.status == TS_OUTRANGE);
+    TypeValue tq[1];
+    n = type_div_n(tq, st, &ta, &tb, 1);
+    assert(n == 1 && st[0] == TS_OUTRANGE);
+
+    /* and on ranges without the small values */
+    other[POWER] = type_conf_int(5, 100);
+    type_config(other, ALL_TYPES);
+    ta = type_seti(type_init(POWER), 100).out;
+    tb = type_seti(type_init(POWER), 50).out;
+    rc = type_div(ta, tb);
+    assert(rc.status == TS_OUTRANGE);
+    type_config(TYPE_CONFIG, ALL_TYPES);
+
+    free(mema);
+    free(memb);
+    free(memo);
+    free(memk);
+    (void)width;
+    (void)n;
+    (void)ts;
+    (void)rc;
+    (void)tv;
+
+    printf("OK\n");
+}/* test_narrow */
+
+void test_fused(void)
+{
+    printf("test_fused: ");
+
+    int count;
+
+    TypeValue l10 = type_seti(type_init(LEVEL), 10).out;
+    TypeValue l20 = type_seti(type_init(LEVEL), 20).out;
+    TypeValue l100 = type_seti(type_init(LEVEL), 100).out;
+    TypeValue lm5 = type_seti(type_init(LEVEL), -5).out;
+    TypeValue lm9 = type_seti(type_init(LEVEL), -950).out;
+
+    TypeResult rc = type_fma(l10, l20, lm5);
+    assert(rc.status == TS_OK && type_int(rc.out) == 195);
+
+    /* the intermediate 10000 is not checked, the result is */
+    TypeValue l15 = type_seti(type_init(LEVEL), 15).out;
+    rc = type_mul(l100, l15);
+    assert(rc.status == TS_OUTRANGE);
+    rc = type_fma(l100, l15, lm9);
+    assert(rc.status == TS_OK && type_int(rc.out) == 550);
+    rc = type_fma(l100, l10, lm9);
+    assert(rc.status == TS_OK && type_int(rc.out) == 50);
+    rc = type_fma(l100, l100, lm5);
+    assert(rc.status == TS_OUTRANGE);
+
+    /* decimals: exact product, one cut to the precision */
+    TypeValue c125 = type_setd(type_init(COEF), 1.25).out;
+    TypeValue c3 = type_setd(type_init(COEF), 3.0).out;
+    TypeValue cm1 = type_setd(type_init(COEF), -1.0).out;
+    TypeValue cm3 = type_setd(type_init(COEF), -3.0).out;
+
+    rc = type_fma(c125, c125, cm1); /* 0.5625 */
+    assert(rc.status == TS_OK && type_float(rc.out) == 0.56);
+
+    rc = type_mul(c3, c3);
+    assert(rc.status == TS_OUTRANGE);
+    rc = type_fma(c3, c3, cm3); /* 9 - 3 */
+    assert(rc.status == TS_OUTRANGE);
+    rc = type_fma(c3, c125, cm3); /* 3.75 - 3 */
+    assert(rc.status == TS_OK && type_float(rc.out) == 0.75);
+    rc = type_fma(c3, cm1, c3);
+    assert(rc.status == TS_OK && rc.out.value == 0);
+
+    rc = type_fma(c3, l10, c3);
+    assert(rc.status == TS_INCOMPATIBLE);
+
+    TypeValue on = type_setn(type_init(STATE), ON).out;
+    rc = type_fma(on, on, on);
+    assert(rc.status == TS_INCOMPATIBLE);
+
+    /* lerp */
+    TypeValue l0 = type_seti(type_init(LEVEL), 0).out;
+    TypeValue l1000 = type_seti(type_init(LEVEL), 1000).out;
+    TypeValue lm999 = type_seti(type_init(LEVEL), -999).out;
+
+    rc = type_lerp(l0, l1000, type_dec(0.25));
+    assert(rc.status == TS_OK && type_int(rc.out) == 250);
+    rc = type_lerp(lm999, l1000, 0);
+    assert(rc.status == TS_OK && type_int(rc.out) == -999);
+    rc = type_lerp(l1000, lm999, type_dec(1.0));
+    assert(rc.status == TS_OK && type_int(rc.out) == -999);
+
+    rc = type_lerp(cm1, c125, type_dec(0.5)); /* 0.125 */
+    assert(rc.status == TS_OK && type_float(rc.out) == 0.12);
+
+    /* the whole 64 bits range */
+    TypeValue wmin = type_seti(type_init(WIDE), LLONG_MIN).out;
+    TypeValue wmax = type_seti(type_init(WIDE), LLONG_MAX).out;
+    rc = type_lerp(wmin, wmax, type_dec(1.0));
+    assert(rc.status == TS_OK);
+
+    /* clamp_add */
+    TypeValue lo = l0;
+    TypeValue hi = type_seti(type_init(LEVEL), 900).out;
+    TypeValue l600 = type_seti(type_init(LEVEL), 600).out;
+
+    rc = type_clamp_add(l600, l600, lo, hi);
+    assert(rc.status == TS_OUTRANGE && type_int(rc.out) == 900);
+    rc = type_clamp_add(l100, lm5, lo, hi);
+    assert(rc.status == TS_OK && type_int(rc.out) == 95);
+    rc = type_clamp_add(lm5, lm5, lo, hi);
+    assert(rc.status == TS_OUTRANGE && type_int(rc.out) == 0);
+
+    TypeValue hmax = type_seti(type_init(HUGE), LONG_MAX).out;
+    rc = type_clamp_add(hmax, hmax, type_seti(type_init(HUGE), 0).out, hmax);
+    assert(rc.status == TS_OUTRANGE && rc.out.value == LONG_MAX);
+
+    /* calibration */
+    TypeValue gain = type_setd(type_init(KHZ), 2.5).out;
+    TypeValue offset = type_setd(type_init(KHZ), -1.0).out;
+    TypeValue x[4] = {type_setd(type_init(KHZ), 1.0).out,
+                      type_setd(type_init(KHZ), -0.002).out,
+                      type_setd(type_init(KHZ), 40000.0).out,
+                      l10};
+    TypeValue out[4];
+    enum TypeStatus st[4];
+
+    count = type_fma_n(out, st, x, gain, offset, 4);
+    assert(count == 2);
+    assert(st[0] == TS_OK && type_float(out[0]) == 1.5);
+    assert(st[1] == TS_OK && type_float(out[1]) == -1.005);
+    assert(st[2] == TS_OUTRANGE);
+    assert(st[3] == TS_INCOMPATIBLE);
+
+    count = type_fma_n(out, st, x, gain, l10, 4);
+    assert(count == 4);
+
+    (void)count;
+    (void)rc;
+    printf("OK\n");
+}/* test_fused */
+
+void test_reduce(void)
+{
+    printf("test_reduce: ");
+
+    int count;
+
+    TypeValue lv[4] = {type_seti(type_init(LEVEL), -999).out,
+                       type_seti(type_init(LEVEL), 1000).out,
+                       type_seti(type_init(LEVEL), 500).out,
+                       type_seti(type_init(LEVEL), 3).out};
+
+    struct TypeReduction r = type_reduce_n(lv, 4);
+    assert(r.status == TS_OK && r.count == 4);
+    assert(type_int(r.total) == 504);
+    assert(type_int(r.min) == -999);
+    assert(type_int(r.max) == 1000);
+    assert(type_int(r.mean) == 126);
+
+    /* only the total is checked, not the partial sums */
+    r = type_reduce_n(lv + 1, 2);
+    assert(r.status == TS_OUTRANGE);
+    assert(type_int(r.mean) == 750);
+
+    r = type_reduce_n(lv, 3);
+    assert(r.status == TS_OK && type_int(r.total) == 501);
+
+    /* beyond 64 bits */
+    TypeValue big[3];
+    for (int i=0; i < 3; i++){
+        big[i] = type_seti(type_init(WIDE), LLONG_MAX - 1).out;
+    }
+    r = type_reduce_n(big, 3);
+    assert(r.status == TS_OUTRANGE);
+    assert(r.mean.value == LLONG_MAX - 1);
+
+    /* the mean at the precision */
+    TypeValue cv[2] = {type_setd(type_init(COEF), 1.25).out,
+                       type_setd(type_init(COEF), 1.26).out};
+    r = type_reduce_n(cv, 2);
+    assert(r.status == TS_OK);
+    assert(type_float(r.total) == 2.51);
+    assert(type_float(r.mean) == 1.25);
+
+    TypeValue mixed[2] = {lv[0], cv[0]};
+    r = type_reduce_n(mixed, 2);
+    assert(r.status == TS_INCOMPATIBLE);
+
+    TypeValue on[1] = {type_setn(type_init(STATE), ON).out};
+    r = type_reduce_n(on, 1);
+    assert(r.status == TS_INCOMPATIBLE);
+
+    /* count */
+    TypeValue lo = type_seti(type_init(LEVEL), 0).out;
+    TypeValue hi = type_seti(type_init(LEVEL), 500).out;
+    count = type_count_n(lv, 4, lo, hi);
+    assert(count == 2);
+    count = type_count_n(cv, 2, lo, hi);
+    assert(count == 0);
+
+    /* columns: every level and the threads give the same results */
+    enum { N = 100003 };
+    void *mem = malloc(type_column_size(N));
+    assert(mem != NULL);
+    TypeColumn col = type_column(HUGE, mem, N);
+    const enum TypeSimd best = type_simd();
+
+    unsigned long long x = 88172645463325252ULL;
+    for (int i=0; i < N; i++){
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        col.values[i] = (long long)(x >> 20) - (1LL << 43); /* both signs */
+    }
+    col.values[7] = LLONG_MIN;
+    col.values[N - 1] = LLONG_MAX;
+
+    long long expected = 0;
+    for (int i=0; i < N; i++){
+        expected += (i == 7 || i == N - 1) ? 0 : col.values[i];
+    }
+    expected += -1; /* LLONG_MIN + LLONG_MAX */
+
+    struct TypeReduction rt;
+
+    for (int level=TYPE_SIMD_SCALAR; level <= TYPE_SIMD_AVX512; level++){
+        type_simd_set(level);
+
+        r = type_column_reduce(&col);
+        assert(r.status == TS_OK && r.count == N);
+        assert(r.total.value == expected);
+        assert(r.min.value == LLONG_MIN && r.max.value == LLONG_MAX);
+        assert(r.mean.value == expected / N);
+
+        rt = type_column_reduce_mt(&col, 4);
+        assert(rt.status == TS_OK);
+        assert(rt.total.value == r.total.value);
+        assert(rt.mean.value == r.mean.value);
+        assert(rt.min.value == r.min.value && rt.max.value == r.max.value);
+    }
+    type_simd_set(best);
+
+    TypeValue hlo = type_seti(type_init(HUGE), 0).out;
+    TypeValue hhi = type_seti(type_init(HUGE), LLONG_MAX).out;
+    int positive = 0;
+    for (int i=0; i < N; i++){
+        positive += (col.values[i] >= 0);
+    }
+    count = type_column_count(&col, hlo, hhi);
+    assert(count == positive);
+
+    free(mem);
+
+    (void)count;
+    (void)r;
+    (void)rt;
+    (void)expected;
+    (void)positive;
+    printf("OK\n");
+}/* test_reduce */
+
+void test_saturate(void)
+{
+    printf("test_saturate: ");
+
+    int count;
+
+    TypeValue l600 = type_seti(type_init(LEVEL), 600).out;
+    TypeValue lm600 = type_seti(type_init(LEVEL), -600).out;
+    TypeValue l40 = type_seti(type_init(LEVEL), 40).out;
+
+    TypeResult rc = type_sum_sat(l600, l600);
+    assert(rc.status == TS_OUTRANGE && type_int(rc.out) == 1000);
+    rc = type_sum_sat(lm600, lm600);
+    assert(rc.status == TS_OUTRANGE && type_int(rc.out) == -999);
+    rc = type_sum_sat(l600, lm600);
+    assert(rc.status == TS_OK && type_int(rc.out) == 0);
+
+    rc = type_mul_sat(l600, lm600);
+    assert(rc.status == TS_OUTRANGE && type_int(rc.out) == -999);
+    rc = type_mul_sat(lm600, lm600);
+    assert(rc.status == TS_OUTRANGE && type_int(rc.out) == 1000);
+
+    /* overflow of 64 bits */
+    TypeValue hmax = type_seti(type_init(HUGE), LONG_MAX).out;
+    TypeValue hmin = type_seti(type_init(HUGE), LONG_MIN).out;
+    rc = type_mul_sat(hmax, hmin);
+    assert(rc.status == TS_OUTRANGE && rc.out.value == LONG_MIN);
+    rc = type_sum_sat(hmax, hmax);
+    assert(rc.status == TS_OUTRANGE && rc.out.value == LONG_MAX);
+
+    /* decimals */
+    TypeValue c2 = type_setd(type_init(COEF), 2.0).out;
+    TypeValue cm2 = type_setd(type_init(COEF), -2.0).out;
+    rc = type_mul_sat(c2, cm2);
+    assert(rc.status == TS_OUTRANGE && type_float(rc.out) == -3.2);
+    rc = type_mul_sat(c2, type_setd(type_init(COEF), 1.5).out);
+    assert(rc.status == TS_OK && type_float(rc.out) == 3.0);
+
+    rc = type_sum_sat(l600, c2);
+    assert(rc.status == TS_INCOMPATIBLE);
+    TypeValue on = type_setn(type_init(STATE), ON).out;
+    rc = type_sum_sat(on, on);
+    assert(rc.status == TS_INCOMPATIBLE);
+
+    /* batch, same results of the single operations */
+    TypeValue a[4] = {l600, lm600, l40, l600};
+    TypeValue b[4] = {l600, l40, l40, c2};
+    TypeValue out[4];
+    enum TypeStatus st[4];
+
+    count = type_mul_sat_n(out, st, a, b, 4);
+    assert(count == 4); /* 40 * 40 too */
+    for (int i=0; i < 4; i++){
+        rc = type_mul_sat(a[i], b[i]);
+        assert(rc.status == st[i]);
+        assert(rc.out.value == out[i].value);
+    }
+
+    /* without status */
+    count = type_sum_sat_n(out, NULL, a, b, 4);
+    assert(count == 2);
+    assert(type_int(out[0]) == 1000);
+    assert(type_int(out[1]) == -560);
+    assert(type_int(out[2]) == 80);
+
+    (void)count;
+    (void)rc;
+    printf("OK\n");
+}/* test_saturate */
+
+void test_acc(void)
+{
+    printf("test_acc: ");
+
+    TypeValue gain = type_setd(type_init(KHZ), 2.5).out;
+    TypeValue offset = type_setd(type_init(KHZ), -1.0).out;
+    TypeValue raw = type_setd(type_init(KHZ), 10.0).out;
+
+    struct TypeAcc acc = type_acc_init();
+    TypeValue x = type_acc(&acc, type_mul(gain, raw));
+    TypeValue y = type_acc(&acc, type_sum(x, offset));
+
+    assert(acc.flags == 0 && acc.failed == -1 && acc.first == TS_OK);
+    assert(acc.count == 2);
+    assert(type_float(y) == 24.0);
+
+    /* the first failure is kept, the chain goes on */
+    TypeValue big = type_setd(type_init(KHZ), 40000.0).out;
+    TypeValue l10 = type_seti(type_init(LEVEL), 10).out;
+
+    x = type_acc(&acc, type_mul(gain, big));    /* 2: out of range */
+    assert(type_float(x) == 65536.0);           /* clamped, valid */
+    y = type_acc(&acc, type_sum(x, l10));       /* 3: incompatible */
+    y = type_acc(&acc, type_sum(y, offset));    /* 4: ok */
+
+    assert(acc.first == TS_OUTRANGE && acc.failed == 2);
+    assert(acc.flags == ((1u << TS_OUTRANGE) | (1u << TS_INCOMPATIBLE)));
+    assert(acc.count == 5);
+
+    /* batch statuses */
+    enum TypeStatus st[3] = {TS_OK, TS_OK, TS_INCOMPATIBLE};
+    acc = type_acc_init();
+    type_acc(&acc, type_sum(l10, l10));
+    type_acc_n(&acc, st, 3);
+    assert(acc.first == TS_INCOMPATIBLE && acc.failed == 3);
+    assert(acc.count == 4);
+
+    printf("OK\n");
+}/* test_acc */
+
+void test_convert(void)
+{
+    printf("test_convert: ");
+
+    int count;
+
+    /* Hz to kHz, without a loss */
+    struct TypeScale hz = type_scale(HUGE, KHZ, 1, 1000);
+    TypeResult rc = type_convert(&hz, type_seti(type_init(HUGE), 1234567).out);
+    assert(rc.status == TS_OK);
+    assert(rc.out.type == KHZ && rc.out.value == type_dec(1234.567));
+
+    rc = type_convert(&hz, type_seti(type_init(HUGE), -1234567).out);
+    assert(rc.status == TS_OK && rc.out.value == type_dec(-1234.567));
+
+    rc = type_convert(&hz, type_seti(type_init(HUGE), 65536000).out);
+    assert(rc.status == TS_OK && rc.out.value == type_dec(65536.0));
+    rc = type_convert(&hz, type_seti(type_init(HUGE), 65536001).out);
+    assert(rc.status == TS_OUTRANGE);
+    rc = type_convert(&hz, type_seti(type_init(HUGE), LLONG_MIN).out);
+    assert(rc.status == TS_OUTRANGE);
+
+    /* truncated to the precision of the target */
+    struct TypeScale k2c = type_scale(KHZ, COEF, 1, 1);
+    rc = type_convert(&k2c, type_setd(type_init(KHZ), 1.239).out);
+    assert(rc.status == TS_OK && rc.out.value == type_dec(1.23));
+    rc = type_convert(&k2c, type_setd(type_init(KHZ), -1.239).out);
+    assert(rc.status == TS_OK && rc.out.value == type_dec(-1.23));
+    rc = type_convert(&k2c, type_setd(type_init(KHZ), 3.209).out);
+    assert(rc.status == TS_OK && rc.out.value == type_dec(3.2));
+    rc = type_convert(&k2c, type_setd(type_init(KHZ), 3.21).out);
+    assert(rc.status == TS_OUTRANGE);
+
+    /* decimal to integer, and the whole range */
+    struct TypeScale w2h = type_scale(WIDE, HUGE, 1, 1);
+    rc = type_convert(&w2h, type_setd(type_init(WIDE), -2.999).out);
+    assert(rc.status == TS_OK && rc.out.value == -2);
+
+    struct TypeScale h2w = type_scale(HUGE, WIDE, 1, 1);
+    rc = type_convert(&h2w, type_seti(type_init(HUGE), LLONG_MAX / 1000).out);
+    assert(rc.status == TS_OK && rc.out.value == LLONG_MAX / 1000 * 1000);
+    rc = type_convert(&h2w, type_seti(type_init(HUGE), LLONG_MAX / 1000 + 1).out);
+    assert(rc.status == TS_OUTRANGE);
+
+    /* v * mul beyond 64 bits, exact with 128 bits integers */
+    struct TypeScale big = type_scale(HUGE, HUGE, 1114, 1841);
+    rc = type_convert(&big, type_seti(type_init(HUGE), -6627828477733598485LL).out);
+#if defined(__SIZEOF_INT128__) && !defined(TYPE_NO_WIDE)
+    assert(rc.status == TS_OK && rc.out.value == -4010538253229347480LL);
+    assert(big.inMin == LLONG_MIN && big.inMax == LLONG_MAX);
+#else
+    assert(rc.status == TS_OUTRANGE);
+#endif
+
+    /* not a scale */
+    struct TypeScale nom = type_scale(STATE, LEVEL, 1, 1);
+    rc = type_convert(&nom, type_setn(type_init(STATE), ON).out);
+    assert(rc.status == TS_INCOMPATIBLE);
+    rc = type_convert(&hz, type_seti(type_init(LEVEL), 1).out);
+    assert(rc.status == TS_INCOMPATIBLE && rc.out.type == KHZ);
+
+    /* batch */
+    TypeValue in[3] = {type_seti(type_init(HUGE), 500).out,
+                       type_seti(type_init(LEVEL), 500).out,
+                       type_seti(type_init(HUGE), 70000000).out};
+    TypeValue out[3];
+    enum TypeStatus st[3];
+    count = type_convert_n(out, st, &hz, in, 3);
+    assert(count == 2);
+    assert(st[0] == TS_OK && out[0].value == type_dec(0.5));
+    assert(st[1] == TS_INCOMPATIBLE && st[2] == TS_OUTRANGE);
+
+    /* columns: every level gives the exact quotient */
+    enum { N = 1003 };
+    void *mi = malloc(type_column_size(N));
+    void *mo = malloc(type_column_size(N));
+    void *mw = malloc(type_column_size(N));
+    void *mb = malloc(type_column_size(N));
+    assert(mi != NULL && mo != NULL && mw != NULL && mb != NULL);
+    TypeColumn ci = type_column(HUGE, mi, N);
+    TypeColumn co = type_column(KHZ, mo, N);
+    TypeColumn cw = type_column(WIDE, mw, N);
+    TypeColumn cb = type_column(HUGE, mb, N);
+    enum TypeStatus cst[N];
+    const enum TypeSimd best = type_simd();
+    int failed;
+
+    struct TypeScale s37 = type_scale(HUGE, KHZ, 3, 7);
+    struct TypeScale s13 = type_scale(HUGE, WIDE, 1, 3);
+
+    for (int level=TYPE_SIMD_SCALAR; level <= TYPE_SIMD_AVX512; level++){
+        type_simd_set(level);
+
+        unsigned long long x = 88172645463325252ULL;
+        int outside = 0;
+        for (int i=0; i < N; i++){
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+            ci.values[i] = (long long)(x >> 45) - (1LL << 18);
+            co.values[i] = -1;
+            long long q = ci.values[i] * 3000 / 7;
+            outside += (q > 65536000) || (q < -65536000);
+        }
+
+        count = type_column_convert(&co, cst, &s37, &ci);
+        assert(count == outside);
+        for (int i=0; i < N; i++){
+            long long q = ci.values[i] * 3000 / 7;
+            if ((q <= 65536000) && (q >= -65536000)){
+                assert(cst[i] == TS_OK && co.values[i] == q);
+            } else {
+                assert(cst[i] == TS_OUTRANGE && co.values[i] == -1);
+            }
+        }
+
+        /* products beyond 2^52 */
+        for (int i=0; i < N; i++){
+            ci.values[i] *= (i % 3 == 0) ? (1LL << 25) : 1;
+        }
+        count = type_column_convert(&cw, cst, &s13, &ci);
+        assert(count == 0);
+        for (int i=0; i < N; i++){
+            assert(cw.values[i] == ci.values[i] * 1000 / 3);
+        }
+
+        /* the same results as the scalar conversion */
+        for (int i=0; i < N; i++){
+            ci.values[i] = (i % 5 == 0) ? LLONG_MIN / (i + 1) : i;
+        }
+        count = type_column_convert(&cb, cst, &big, &ci);
+        failed = 0;
+        for (int i=0; i < N; i++){
+            TypeValue v = {.type = HUGE, .value = ci.values[i]};
+            rc = type_convert(&big, v);
+            failed += (rc.status != TS_OK);
+            assert(cst[i] == rc.status);
+            assert(rc.status != TS_OK || cb.values[i] == rc.out.value);
+        }
+        assert(count == failed);
+    }
+    type_simd_set(best);
+
+    count = type_column_convert(&co, cst, &s37, &co);
+    assert(count == N);
+    assert(cst[0] == TS_INCOMPATIBLE);
+
+    free(mi);
+    free(mo);
+    free(mw);
+    free(mb);
+
+    (void)count;
+    printf("OK\n");
+}/* test_convert */
+
+void test_file(void)
+{
+    printf("test_file: ");
+
+    const char *path = "tests_file.tmp";
+    enum { LA = 100, LB = 37 };
+    void *ma = malloc(type_column_size(LA));
+    void *mb = malloc(type_column_size(LB));
+    assert(ma != NULL && mb != NULL);
+
+    TypeColumn cols[2] = {type_column(LEVEL, ma, LA), type_column(KHZ, mb, LB)};
+    for (int i=0; i < LA; i++){
+        cols[0].values[i] = i * 10 - 500;
+        cols[0].timestamps[i] = 1000 + i;
+    }
+    for (int i=0; i < LB; i++){
+        cols[1].values[i] = type_dec(i * 1.5);
+        cols[1].timestamps[i] = 2000 + i;
+    }
+
+    enum TypeFileStatus fs;
+    TypeFile f;
+
+    fs = type_file_write(path, cols, 2);
+    assert(fs == TF_OK);
+
+    fs = type_file_open(&f, path);
+    assert(fs == TF_OK);
+    assert(f.columns == 2);
+
+    for (int c=0; c < 2; c++){
+        TypeColumn col = type_file_column(&f, c);
+        assert(col.type == cols[c].type && col.len == cols[c].len);
+        assert((uintptr_t)col.values % TYPE_COLUMN_ALIGN == 0);
+        assert((uintptr_t)col.timestamps % TYPE_COLUMN_ALIGN == 0);
+        assert(memcmp(col.values, cols[c].values,
+                      col.len * sizeof(type_value_store)) == 0);
+        assert(memcmp(col.timestamps, cols[c].timestamps,
+                      col.len * sizeof(type_millisecs)) == 0);
+        (void)col;
+    }
+
+    /* the mapping is private and the columns work as the others */
+    TypeColumn lv = type_file_column(&f, 0);
+    enum TypeStatus st[LA];
+    int n = type_column_sum(&lv, st, &lv, &lv);
+    assert(n > 0);
+    type_file_close(&f);
+
+    fs = type_file_open(&f, path);
+    assert(fs == TF_OK);
+    lv = type_file_column(&f, 0);
+    assert(lv.values[LA - 1] == cols[0].values[LA - 1]);
+    type_file_close(&f);
+
+    /* another configuration */
+    struct TypeConf other[ALL_TYPES];
+    memcpy(other, TYPE_CONFIG, sizeof(other));
+    other[LEVEL] = type_conf_int(-999, 999);
+    type_config(other, ALL_TYPES);
+    fs = type_file_open(&f, path);
+    assert(fs == TF_CONFIG);
+    type_config(TYPE_CONFIG, ALL_TYPES);
+    fs = type_file_open(&f, path);
+    assert(fs == TF_OK);
+    type_file_close(&f);
+
+    /* replaced while mapped, the old mapping stays whole */
+    fs = type_file_open(&f, path);
+    assert(fs == TF_OK);
+    fs = type_file_write(path, NULL, 0);
+    assert(fs == TF_OK);
+    lv = type_file_column(&f, 1);
+    assert(lv.values[LB - 1] == cols[1].values[LB - 1]);
+    type_file_close(&f);
+
+    fs = type_file_write(path, cols, 2);
+    assert(fs == TF_OK);
+
+    /* values from outside */
+    cols[0].values[3] = 5000;
+    fs = type_file_write(path, cols, 2);
+    assert(fs == TF_OK);
+    fs = type_file_open(&f, path);
+    assert(fs == TF_OUTRANGE);
+    assert(f.map == NULL);
+
+    /* truncated, not a column file, missing */
+    FILE *raw = fopen(path, "wb");
+    assert(raw != NULL);
+    fputs("not a column file, not a column file, not a column file, "
+          "not a column file", raw);
+    fclose(raw);
+    fs = type_file_open(&f, path);
+    assert(fs == TF_FORMAT);
+
+    remove(path);
+    fs = type_file_open(&f, path);
+    assert(fs == TF_IO);
+
+    /* no columns */
+    fs = type_file_write(path, NULL, 0);
+    assert(fs == TF_OK);
+    fs = type_file_open(&f, path);
+    assert(fs == TF_OK && f.columns == 0);
+    type_file_close(&f);
+    remove(path);
+
+    free(ma);
+    free(mb);
+    (void)fs;
+    (void)n;
+
+    printf("OK\n");
+}/* test_file */
+
+struct RingJob {
+    TypeRing *ring;
+    const TypeValue *v;
+    int n;
+};
+
+/* push all the values in small batches */
+static
+void *ring_producer(void *arg)
+{
+    struct RingJob *job = arg;
+    int done = 0;
+
+    while (done < job->n){
+        int batch = (job->n - done < 64) ? job->n - done : 64;
+        int k = type_ring_push_n(job->ring, job->v + done, batch);
+        if (k == 0){
+            sched_yield();
+        }
+        done += k;
+    }
+
+    return NULL;
+}/* ring_producer */
+
+/* producers threads on a ring, the values are p * n + i */
+static
+void ring_run(enum TypeRingMode mode, int producers, int n)
+{
+    void *mem = malloc(type_ring_size(256));
+    TypeValue *v = malloc(sizeof(TypeValue) * producers * n);
+    assert(mem != NULL && v != NULL);
+
+    TypeRing *r = type_ring(mem, 256, mode);
+    for (int i=0; i < producers * n; i++){
+        v[i] = type_seti(type_init(HUGE), i).out;
+    }
+
+    pthread_t th[4];
+    struct RingJob jobs[4];
+    int next[4] = {0};
+    int rc;
+    assert(producers <= 4);
+
+    for (int p=0; p < producers; p++){
+        jobs[p] = (struct RingJob){.ring = r, .v = v + p * n, .n = n};
+        rc = pthread_create(&th[p], NULL, ring_producer, &jobs[p]);
+        assert(rc == 0);
+    }
+
+    /* FIFO for every producer */
+    TypeValue buf[100];
+    int total = 0;
+    while (total < producers * n){
+        int k = type_ring_pop_n(r, buf, 100);
+        if (k == 0){
+            sched_yield();
+        }
+        for (int i=0; i < k; i++){
+            int p = (int)(buf[i].value / n);
+            assert(buf[i].type == HUGE);
+            assert(buf[i].value % n == next[p]);
+            next[p]++;
+        }
+        total += k;
+    }
+
+    for (int p=0; p < producers; p++){
+        rc = pthread_join(th[p], NULL);
+        assert(rc == 0);
+        assert(next[p] == n);
+    }
+    assert(type_ring_count(r) == 0);
+
+    free(v);
+    free(mem);
+    (void)rc;
+}/* ring_run */
+
+void test_ring(void)
+{
+    printf("test_ring: ");
+
+    int count;
+
+    void *mem = malloc(type_ring_size(8));
+    assert(mem != NULL);
+
+    /* single thread, full, empty and wrap */
+    TypeValue in[10];
+    TypeValue out[10];
+    for (int i=0; i < 10; i++){
+        in[i] = type_seti(type_init(LEVEL), i * 100).out;
+    }
+
+    for (int m=TYPE_RING_SPSC; m <= TYPE_RING_MPSC; m++){
+        TypeRing *r = type_ring(mem, 8, (enum TypeRingMode)m);
+        assert((uintptr_t)r % TYPE_COLUMN_ALIGN == 0);
+        count = type_ring_pop_n(r, out, 10);
+        assert(count == 0);
+
+        count = type_ring_push_n(r, in, 5);
+        assert(count == 5);
+        count = type_ring_pop_n(r, out, 3);
+        assert(count == 3);
+        assert(out[0].value == 0 && out[2].value == 200);
+        count = type_ring_push_n(r, in, 10);
+        assert(count == 6);
+        assert(type_ring_count(r) == 8);
+        count = type_ring_push_n(r, in, 1);
+        assert(count == 0);
+
+        count = type_ring_pop_n(r, out, 10);
+        assert(count == 8);
+        assert(out[0].value == 300 && out[1].value == 400);
+        for (int i=0; i < 6; i++){
+            assert(out[i + 2].value == in[i].value);
+            assert(out[i + 2].timestamp == in[i].timestamp);
+        }
+        assert(type_ring_count(r) == 0);
+    }
+    free(mem);
+
+    /* packed values */
+    mem = malloc(type_ring_packed_size(4));
+    assert(mem != NULL);
+    TypeRing *pr = type_ring_packed(mem, 4, TYPE_RING_MPSC);
+
+    type_packed pin[3];
+    type_packed pout[3];
+    enum TypeStatus pst[3];
+    count = type_pack_n(pin, pst, in, 3);
+    assert(count == 0);
+    count = type_ring_push_packed_n(pr, pin, 3);
+    assert(count == 3);
+    count = type_ring_pop_packed_n(pr, pout, 3);
+    assert(count == 3);
+    struct TypePackedResult sum = type_pack_sum(pout[1], pout[2]);
+    assert(sum.status == TS_OK);
+    assert(type_unpack(sum.out).value == 300);
+    free(mem);
+
+    /* in a column, then the column operations */
+    mem = malloc(type_ring_size(16));
+    void *cm = malloc(type_column_size(4));
+    assert(mem != NULL && cm != NULL);
+
+    TypeRing *r = type_ring(mem, 16, TYPE_RING_SPSC);
+    TypeColumn col = type_column(LEVEL, cm, 4);
+    enum TypeStatus st[4];
+
+    TypeValue mixed[3] = {in[1], type_seti(type_init(POWER), 7).out, in[2]};
+    count = type_ring_push_n(r, mixed, 3);
+    assert(count == 3);
+    count = type_ring_pop_column(r, &col, st);
+    assert(count == 3);
+    assert(st[0] == TS_OK && st[1] == TS_INCOMPATIBLE && st[2] == TS_OK);
+    assert(col.values[0] == 100 && col.values[1] == 0 && col.values[2] == 200);
+    assert(col.timestamps[2] == in[2].timestamp);
+    count = type_column_validate(&col, NULL);
+    assert(count == 0);
+
+    count = type_ring_push_n(r, in, 6);
+    assert(count == 6);
+    count = type_ring_pop_column(r, &col, NULL);
+    assert(count == 4);
+    assert(col.values[3] == 300);
+    assert(type_ring_count(r) == 2);
+
+    free(cm);
+    free(mem);
+
+    /* threads */
+    ring_run(TYPE_RING_SPSC, 1, 20000);
+    ring_run(TYPE_RING_MPSC, 3, 20000);
+
+    (void)count;
+    (void)sum;
+    printf("OK\n");
+}/* test_ring */
+
+void test_stale(void)
+{
+    printf("test_stale: ");
+
+    int count;
+
+    enum { CH = 6 };
+    void *mem = malloc(type_stale_size(CH));
+    assert(mem != NULL);
+
+    TypeStale *s = type_stale(mem, CH);
+    int out[CH];
+
+    /* never set, stale for any deadline after 0 */
+    count = type_stale_query(s, 0, out, CH);
+    assert(count == 0);
+    count = type_stale_query(s, 1, out, CH);
+    assert(count == CH);
+    count = type_stale_query(s, 1, out, 2);
+    assert(count == 2);
+
+    /* through the values */
+    type_time_begin_at(100);
+    TypeValue a = type_seti(type_init(LEVEL), 5).out;
+    type_time_end();
+    for (int ch=0; ch < CH; ch++){
+        type_stale_put(s, ch, a);
+    }
+
+    type_time_begin_at(200);
+    TypeValue b[3];
+    enum TypeStatus st[3];
+    TypeValue big[3] = {a, type_seti(type_init(LEVEL), 999).out, a};
+    int chs[3] = {4, 1, 2};
+    count = type_sum_n(b, st, big, big, 3);
+    assert(count == 1); /* 1998 out of range */
+    type_time_end();
+    count = type_stale_put_n(s, chs, b, st, 3);
+    assert(count == 1);
+
+    /* 0, 1, 3, 5 at 100, then 4, 2 at 200 */
+    count = type_stale_query(s, 100, out, CH);
+    assert(count == 0);
+    count = type_stale_query(s, 150, out, CH);
+    assert(count == 4);
+    assert(out[0] == 0 && out[1] == 1 && out[2] == 3 && out[3] == 5);
+    assert(type_stale_time(s, 4) == 200 && type_stale_time(s, 1) == 100);
+
+    /* out of order, it goes between */
+    type_stale_touch(s, 5, 150);
+    type_stale_touch(s, 0, 300);
+    type_stale_touch(s, 3, 50);
+    count = type_stale_query(s, 1000, out, CH);
+    assert(count == CH);
+    assert(out[0] == 3 && out[1] == 1 && out[2] == 5 &&
+           out[3] == 4 && out[4] == 2 && out[5] == 0);
+    count = type_stale_query(s, 200, out, CH);
+    assert(count == 3);
+
+    /* the tail again */
+    type_stale_touch(s, 0, 400);
+    count = type_stale_query(s, 400, out, CH);
+    assert(count == 5);
+
+    free(mem);
+
+    (void)count;
+    printf("OK\n");
+}/* test_stale */
+
+static bool sharedStop = false;
+
+/* the writer of a channel, value and timestamp change together */
+static
+void *shared_writer(void *arg)
+{
+    TypeShared *sh = arg;
+    enum TypeStatus st;
+
+    for (int i=1; !__atomic_load_n(&sharedStop, __ATOMIC_ACQUIRE); i++){
+        type_time_begin_at((type_millisecs)i);
+        TypeValue tv = type_seti(type_init(HUGE), i).out;
+        type_time_end();
+
+        st = type_shared_put(sh, 1, tv);
+        assert(st == TS_OK);
+    }
+
+    (void)st;
+    return NULL;
+}/* shared_writer */
+
+/* the counter of a slot, see the layout in strongtypes_file.h */
+static
+uint64_t *shared_seq(TypeShared *sh, int ch)
+{
+    return (uint64_t *)((char *)sh->map + 64 + 64 * ch);
+}/* shared_seq */
+
+void test_shared(void)
+{
+    printf("test_shared: ");
+
+    const char *path = "tests_shared.tmp";
+    int types[3] = {LEVEL, HUGE, KHZ};
+    enum TypeFileStatus fs;
+    enum TypeStatus st;
+    int n;
+
+    TypeShared w;
+    fs = type_shared_create(&w, path, types, 3);
+    assert(fs == TF_OK);
+    assert(w.writer && w.channels == 3);
+
+    TypeShared r;
+    TypeValue tv;
+    fs = type_shared_open(&r, path);
+    assert(fs == TF_OK);
+    assert(!r.writer && r.channels == 3);
+    fs = type_shared_get(&r, 2, &tv);
+    assert(fs == TF_OK);
+    assert(tv.type == KHZ && tv.value == 0);
+
+    /* the reader sees the writes through its own mapping */
+    TypeValue in[3] = {type_seti(type_init(LEVEL), 10).out,
+                       type_seti(type_init(HUGE), 20).out,
+                       type_setd(type_init(KHZ), 1.5).out};
+    n = type_shared_put_n(&w, 0, in, NULL, 3);
+    assert(n == 0);
+    st = type_shared_put(&w, 0, in[2]);
+    assert(st == TS_INCOMPATIBLE);
+
+    TypeValue out[3];
+    enum TypeFileStatus fst[3];
+    n = type_shared_get_n(&r, 0, out, fst, 3);
+    assert(n == 0);
+    for (int i=0; i < 3; i++){
+        assert(fst[i] == TF_OK);
+        assert(out[i].type == in[i].type && out[i].value == in[i].value);
+        assert(out[i].timestamp == in[i].timestamp);
+    }
+
+    /* only the TS_OK */
+    enum TypeStatus sts[2] = {TS_OUTRANGE, TS_OK};
+    TypeValue more[2] = {type_seti(type_init(LEVEL), 11).out,
+                         type_seti(type_init(HUGE), 21).out};
+    n = type_shared_put_n(&w, 0, more, sts, 2);
+    assert(n == 1);
+    fs = type_shared_get(&r, 0, &tv);
+    assert(fs == TF_OK && tv.value == 10);
+    fs = type_shared_get(&r, 1, &tv);
+    assert(fs == TF_OK && tv.value == 21);
+
+    /* a reader never sees half a write */
+    pthread_t th;
+    int rc = pthread_create(&th, NULL, shared_writer, &w);
+    assert(rc == 0);
+    type_millisecs last = 0;
+    int changes = 0;
+    for (int i=0; i < 20000 || changes < 100; i++){
+        if (i % 1000 == 0){
+            sched_yield(); /* let the writer run */
+        }
+        fs = type_shared_get(&r, 1, &tv);
+        assert(fs == TF_OK);
+        assert((type_millisecs)tv.value == tv.timestamp || tv.value == 21);
+        assert(tv.timestamp >= last);
+        changes += (tv.timestamp != last);
+        last = tv.timestamp;
+    }
+    __atomic_store_n(&sharedStop, true, __ATOMIC_RELEASE);
+    rc = pthread_join(th, NULL);
+    assert(rc == 0);
+    fs = type_shared_get(&r, 1, &tv);
+    assert(fs == TF_OK && tv.value > 21 && changes > 0);
+
+    /* a writer dead in an update, the readers do not wait for ever */
+    (*shared_seq(&w, 2))++;
+    fs = type_shared_get(&r, 2, &tv);
+    assert(fs == TF_BUSY);
+    n = type_shared_get_n(&r, 1, out, fst, 2);
+    assert(n == 1 && fst[0] == TF_OK && fst[1] == TF_BUSY);
+    fs = type_shared_open(&r, path);
+    assert(fs == TF_BUSY);
+    (*shared_seq(&w, 2))++;
+
+    /* values from outside */
+    ((int64_t *)shared_seq(&w, 0))[2] = 5000; /* after seq, type */
+    fs = type_shared_open(&r, path);
+    assert(fs == TF_OUTRANGE);
+    ((int64_t *)shared_seq(&w, 0))[2] = 10;
+
+    /* another configuration */
+    fs = type_shared_open(&r, path);
+    assert(fs == TF_OK);
+    struct TypeConf other[ALL_TYPES];
+    memcpy(other, TYPE_CONFIG, sizeof(other));
+    other[KHZ] = type_conf_dec(type_dec(-1.0), type_dec(1.0), 3);
+    type_config(other, ALL_TYPES);
+    TypeShared r2;
+    fs = type_shared_open(&r2, path);
+    assert(fs == TF_CONFIG);
+    type_config(TYPE_CONFIG, ALL_TYPES);
+
+    /* created again, the old readers keep the old store */
+    type_shared_close(&w);
+    assert(w.map == NULL);
+    fs = type_shared_create(&w, path, types, 2);
+    assert(fs == TF_OK);
+    fs = type_shared_get(&r, 2, &tv);
+    assert(fs == TF_OK && tv.type == KHZ && tv.value == in[2].value);
+    type_shared_close(&r);
+    fs = type_shared_open(&r, path);
+    assert(fs == TF_OK && r.channels == 2);
+    type_shared_close(&r);
+    type_shared_close(&w);
+
+    /* not a store */
+    fs = type_file_write(path, NULL, 0);
+    assert(fs == TF_OK);
+    fs = type_shared_open(&r, path);
+    assert(fs == TF_FORMAT);
+    remove(path);
+    fs = type_shared_open(&r, path);
+    assert(fs == TF_IO);
+
+    (void)fs;
+    (void)st;
+    (void)n;
+    (void)rc;
+
+    printf("OK\n");
+}/* test_shared */
+
+#ifdef TYPE_STATS
+static
+void *stats_worker(void *arg)
+{
+    (void)arg;
+    type_sum(type_seti(type_init(LEVEL), 999).out,
+             type_seti(type_init(LEVEL), 999).out); /* out of range */
+    return NULL;
+}
+
+void test_stats(void)
+{
+    printf("test_stats: ");
+
+    struct TypeStats before;
+    struct TypeStats after;
+    struct TypeStats all;
+    char buf[TYPE_STR_LEN];
+    char line[64];
+    static char mema[1024];
+    static char memo[1024];
+    TypeColumn col = type_column(LEVEL, mema, 4);
+    TypeColumn prod = type_column(LEVEL, memo, 4);
+    enum TypeStatus st[4];
+    TypeValue out[3];
+
+    for (int i=0; i < 4; i++){
+        col.values[i] = 10 * i;
+    }
+    col.values[3] = 40;
+
+    type_stats_thread(&before);
+
+    TypeValue l = type_seti(type_init(LEVEL), 10).out;
+    type_seti(l, 2000);                         /* out of range */
+    type_setd(type_init(LEVEL), 1.0);           /* incompatible */
+    type_sum(l, l);
+    type_mul(l, type_init(POWER));              /* incompatible */
+    type_div(l, type_init(LEVEL));              /* by zero */
+    type_str(buf, l);
+
+    /* a batch counts its n operations at once */
+    TypeValue big = {.type = LEVEL, .value = 1000};
+    TypeValue v[3] = {l, big, l};
+    type_sum_n(out, st, v, v, 3);               /* 1000 + 1000 out of range */
+    type_column_mul(&prod, st, &col, &col);     /* 40 * 40 out of range */
+    type_str_n(line, sizeof(line), v, 3, ';');
+
+    type_stats_thread(&after);
+
+    const struct TypeStat *b = before.stat[LEVEL];
+    const struct TypeStat *a = after.stat[LEVEL];
+    assert(a[TYPE_OP_SETI].ops - b[TYPE_OP_SETI].ops == 2);
+    assert(a[TYPE_OP_SETI].outrange - b[TYPE_OP_SETI].outrange == 1);
+    assert(a[TYPE_OP_SETD].incompatible - b[TYPE_OP_SETD].incompatible == 1);
+    assert(a[TYPE_OP_SUM].ops - b[TYPE_OP_SUM].ops == 1 + 3);
+    assert(a[TYPE_OP_SUM].outrange - b[TYPE_OP_SUM].outrange == 1);
+    assert(a[TYPE_OP_MUL].ops - b[TYPE_OP_MUL].ops == 1 + 4);
+    assert(a[TYPE_OP_MUL].outrange - b[TYPE_OP_MUL].outrange == 1);
+    assert(a[TYPE_OP_MUL].incompatible - b[TYPE_OP_MUL].incompatible == 1);
+    assert(a[TYPE_OP_DIV].outrange - b[TYPE_OP_DIV].outrange == 1);
+    assert(a[TYPE_OP_STR].ops - b[TYPE_OP_STR].ops == 1 + 3);
+
+    /* the counters of an ended thread are kept */
+    type_stats(&before);
+
+    pthread_t th;
+    int rc = pthread_create(&th, NULL, stats_worker, NULL);
+    assert(rc == 0);
+    rc = pthread_join(th, NULL);
+    assert(rc == 0);
+
+    type_stats(&all);
+    assert(all.stat[LEVEL][TYPE_OP_SETI].ops ==
+           before.stat[LEVEL][TYPE_OP_SETI].ops + 2);
+    assert(all.stat[LEVEL][TYPE_OP_SUM].outrange ==
+           before.stat[LEVEL][TYPE_OP_SUM].outrange + 1);
+
+    type_stats_merge(&all, &all);
+    assert(all.stat[LEVEL][TYPE_OP_SETI].ops ==
+           2 * (before.stat[LEVEL][TYPE_OP_SETI].ops + 2));
+
+    (void)a;
+    (void)b;
+    (void)rc;
+    printf("OK\n");
+}/* test_stats */
+#endif
+
+#ifdef TYPE_PROFILE
+void test_profile(void)
+{
+    printf("test_profile: ");
+
+    static struct TypeProfile before;
+    static struct TypeProfile after;
+    static struct TypeProfile all;
+
+    type_profile_thread(&before);
+
+    TypeValue l = type_seti(type_init(LEVEL), 10).out;
+    TypeValue k = type_setd(type_init(KHZ), 1.5).out;
+    for (int i=0; i < 100; i++){
+        type_sum(l, l);
+        type_div(k, k);
+    }
+    type_sum(l, k); /* incompatible, still measured */
+
+    /* a ring measures its batches, not its size and constructor */
+    void *mem = malloc(type_ring_size(8));
+    assert(mem != NULL);
+    TypeRing *r = type_ring(mem, 8, TYPE_RING_SPSC);
+    TypeValue ring[4] = {l, l, l, l};
+    type_ring_push_n(r, ring, 4);
+    type_ring_pop_n(r, ring, 4);
+    free(mem);
+
+#ifdef TYPE_TIMESTAMP
+    /* a put is measured once, not also as a touch */
+    mem = malloc(type_stale_size(2));
+    assert(mem != NULL);
+    TypeStale *s = type_stale(mem, 2);
+    type_stale_put(s, 1, l);
+    free(mem);
+#endif
+
+    type_profile_thread(&after);
+
+    const struct TypeProfHist *b = &before.hist[TYPE_PROF_SUM][INTEGER];
+    const struct TypeProfHist *a = &after.hist[TYPE_PROF_SUM][INTEGER];
+    assert(a->count - b->count == 101);
+    assert(a->total >= b->total);
+
+    unsigned long long samples = 0;
+    for (int i=0; i < TYPE_PROF_BUCKETS; i++){
+        samples += a->bucket[i];
+    }
+    assert(samples == a->count);
+
+    /* type_setd measures also its type_setds */
+    assert(after.hist[TYPE_PROF_SETD][DECIMAL].count -
+           before.hist[TYPE_PROF_SETD][DECIMAL].count == 1);
+    assert(after.hist[TYPE_PROF_SETDS][DECIMAL].count -
+           before.hist[TYPE_PROF_SETDS][DECIMAL].count == 1);
+    assert(after.hist[TYPE_PROF_DIV][DECIMAL].count -
+           before.hist[TYPE_PROF_DIV][DECIMAL].count == 100);
+    assert(after.hist[TYPE_PROF_RING_PUSH_N][INTEGER].count -
+           before.hist[TYPE_PROF_RING_PUSH_N][INTEGER].count == 1);
+    /* a pop has no type yet */
+    const int none = TYPE_PROF_CATEGORIES - 1;
+    assert(after.hist[TYPE_PROF_RING_POP_N][none].count -
+           before.hist[TYPE_PROF_RING_POP_N][none].count == 1);
+#ifdef TYPE_TIMESTAMP
+    assert(after.hist[TYPE_PROF_STALE_PUT][INTEGER].count -
+           before.hist[TYPE_PROF_STALE_PUT][INTEGER].count == 1);
+    assert(after.hist[TYPE_PROF_STALE_TOUCH][none].count ==
+           before.hist[TYPE_PROF_STALE_TOUCH][none].count);
+#endif
+
+#ifdef NDEBUG
+    assert(after.asserts == 0);
+#else
+    assert(after.asserts == 1);
+#endif
+
+    type_profile(&all);
+    assert(all.hist[TYPE_PROF_SUM][INTEGER].count >= a->count);
+
+    type_profile_merge(&all, &all);
+    assert(all.hist[TYPE_PROF_SUM][INTEGER].count >= 2 * a->count);
+
+    /* one line for every operation and category with samples */
+    char buf[4096];
+    FILE *f = tmpfile();
+    assert(f != NULL);
+    type_profile_dump(f, &after);
+    rewind(f);
+    size_t len = fread(buf, 1, sizeof(buf) - 1, f);
+    buf[len] = '\0';
+    fclose(f);
+    assert(strncmp(buf, "op,category,asserts,unit,", 25) == 0);
+    assert(strstr(buf, "\nsum,INTEGER,") != NULL);
+    assert(strstr(buf, "\ndiv,DECIMAL,") != NULL);
+
+    (void)b;
+    (void)none;
+    printf("OK\n");
+}/* test_profile */
+#endif
+
+
+
+
+
+
+
+
+
+
+
+
 
 int main()
 {
@@ -349,6 +2655,34 @@ int main()
     test_khz();
     test_str();
     test_timestamp();
+    test_batch();
+    test_column();
+    test_simd();
+    test_config();
+    test_wide();
+    test_parse();
+    test_setdec();
+    test_time_scope();
+    test_context();
+    test_reconfig();
+    test_reconfig_writers();
+    test_pack();
+    test_narrow();
+    test_fused();
+    test_reduce();
+    test_saturate();
+    test_acc();
+    test_convert();
+    test_file();
+    test_ring();
+    test_stale();
+    test_shared();
+#ifdef TYPE_STATS
+    test_stats();
+#endif
+#ifdef TYPE_PROFILE
+    test_profile();
+#endif
 
     return 0;
 }
@@ -12,45 +12,556 @@
  * Author: Omar Rampado <omar@ognibit.it>
  */
 
-#ifndef _GNU_SOURCE
-#define _GNU_SOURCE    // exp10
+#if defined(TYPE_PROFILE) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200112L /* clock_gettime */
 #endif
 
 #include "strongtypes.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
-#include <math.h>
 #include <string.h>
+#include <stdint.h>
+#include <limits.h>
 #include <err.h>
 #include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(TYPE_NO_SIMD)
+#define TYPE_X86_SIMD
+#include <immintrin.h>
+#endif
+
+#ifdef TYPE_PROFILE
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(TYPE_PROFILE_CLOCK)
+#define PROF_TSC
+#include <x86intrin.h>
+#else
+#include <time.h>
+#endif
+#endif
 
 #ifndef TYPE_DECIMAL_DIGITS
 #define TYPE_DECIMAL_DIGITS 3
 #define TYPE_DECIMAL_POWER  1000
 #endif
 
-static const struct TypeConf *config = NULL;
-static int configLen = 0;
+/* packed values: type in the lowest bits, signed value in the others */
+#define PACK_VALUE_BITS (64 - TYPE_PACK_TYPE_BITS)
+#define PACK_TYPE_MASK  ((1ULL << TYPE_PACK_TYPE_BITS) - 1)
+#define PACK_MAX        ((type_value_store)((1ULL << (PACK_VALUE_BITS - 1)) - 1))
+#define PACK_MIN        (-PACK_MAX - 1)
+
+/* 128 bits integers for the exact intermediate results */
+#if defined(__SIZEOF_INT128__) && !defined(TYPE_NO_WIDE)
+#define TYPE_WIDE
+__extension__ typedef __int128 type_wide;
+__extension__ typedef unsigned __int128 type_uwide;
+#endif
+
+/* Compiled configuration of a type, built once by type_config.
+ * All the fields used by the operations are in a single record, so a type
+ * costs one cache line access and no floating point on the hot path.
+ */
+struct TypeDesc {
+    type_value_store rangeMin;
+    type_value_store rangeMax;
+    type_value_store cut;       /* 10^(DIGITS - precision), 1 if not DECIMAL */
+    unsigned long long cutInv;  /* floor((2^64 - 1) / cut) */
+    enum TypeCategory category;
+    int precision;
+    bool packable;              /* index and range fit a type_packed */
+};
+
+/* Compiled table of a configuration */
+struct TypeTable {
+    int len;
+    struct TypeDesc desc[]; /* len records */
+};
+
+struct TypeContext {
+    struct TypeTable *table;
+};
+
+/* valid, empty table before the configuration */
+static struct TypeTable emptyTable = {.len = 0};
+
+/* the context of the global API (type_config) */
+static TypeContext defaultContext = {.table = &emptyTable};
+
+/* context bound to the current thread, NULL for the default one */
+static __thread TypeContext *boundContext = NULL;
+
+/* The table of the current context.
+ * Every operation reads it once and uses it for all the checks.
+ * The load pairs with the publication in type_context_config().
+ */
+static inline
+const struct TypeTable *type_table(void)
+{
+    TypeContext *ctx = (boundContext != NULL) ? boundContext
+                                              : &defaultContext;
+    return __atomic_load_n(&ctx->table, __ATOMIC_ACQUIRE);
+}/* type_table */
+
+/* Grace periods, quiescent state based.
+ * Every online thread records the last period it has seen; a writer starts
+ * a new period and waits until all the online threads have seen it (or
+ * gone offline), so none of them can still use the old table.
+ * The lock protects only the list and serializes the writers.
+ */
+struct TypeReader {
+    unsigned long period;       /* 0 when offline */
+    struct TypeReader *next;
+};
+
+static pthread_mutex_t graceLock = PTHREAD_MUTEX_INITIALIZER;
+static struct TypeReader *readers = NULL;
+static unsigned long gracePeriod = 1;
+static __thread struct TypeReader reader = {.period = 0, .next = NULL};
+
+#ifdef TYPE_TIMESTAMP
+/* Time scope of the current thread: when open, all the operations use the
+ * cached time instead of calling type_now().
+ */
+static __thread type_millisecs scopeTime = 0;
+static __thread bool scopeOpen = false;
+
+static inline
+type_millisecs type_stamp(void)
+{
+    return scopeOpen ? scopeTime : type_now();
+}/* type_stamp */
+#endif
+
+#if defined(TYPE_STATS) || defined(TYPE_PROFILE)
+/* Counters of a thread, the padding keeps the counters of two threads on
+ * different cache lines. Only the owner writes them, the relaxed accesses
+ * let the snapshots read them at any time.
+ */
+struct ThreadBlock {
+    char before[64];
+#ifdef TYPE_STATS
+    struct TypeStats stats;
+#endif
+#ifdef TYPE_PROFILE
+    struct TypeProfile profile;
+#endif
+    struct ThreadBlock *next;
+    char after[64];
+};
+
+static pthread_mutex_t blocksLock = PTHREAD_MUTEX_INITIALIZER;
+static struct ThreadBlock *threadBlocks = NULL; /* of the running threads */
+static pthread_once_t blocksOnce = PTHREAD_ONCE_INIT;
+static pthread_key_t blocksKey;
+static __thread struct ThreadBlock *threadBlock = NULL;
+
+#ifdef TYPE_STATS
+static struct TypeStats statsEnded;             /* of the ended threads */
+#endif
+#ifdef TYPE_PROFILE
+static struct TypeProfile profileEnded;
+static void profile_init(struct TypeProfile *p);
+#endif
+
+static inline
+void stat_add(unsigned long long *counter, unsigned long long n)
+{
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + n,
+                     __ATOMIC_RELAXED);
+}/* stat_add */
+
+static inline
+unsigned long long stat_load(const unsigned long long *counter)
+{
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}/* stat_load */
+
+/* at the thread end, its counters go in the ones of the ended threads */
+static
+void block_thread_end(void *arg)
+{
+    struct ThreadBlock *b = arg;
+
+    pthread_mutex_lock(&blocksLock);
+    for (struct ThreadBlock **p = &threadBlocks; *p != NULL; p = &(*p)->next){
+        if (*p == b){
+            *p = b->next;
+            break;
+        }
+    }
+#ifdef TYPE_STATS
+    type_stats_merge(&statsEnded, &b->stats);
+#endif
+#ifdef TYPE_PROFILE
+    type_profile_merge(&profileEnded, &b->profile);
+#endif
+    pthread_mutex_unlock(&blocksLock);
+
+    free(b);
+}/* block_thread_end */
+
+static
+void block_key_init(void)
+{
+    if (pthread_key_create(&blocksKey, block_thread_end) != 0){
+        errx(EXIT_FAILURE, "Cannot create the thread counters key");
+    }
+#ifdef TYPE_PROFILE
+    profile_init(&profileEnded);
+#endif
+}/* block_key_init */
+
+/* the counters of the current thread, created at the first use */
+static
+struct ThreadBlock *block_create(void)
+{
+    struct ThreadBlock *b = calloc(1, sizeof(struct ThreadBlock));
+    if (b == NULL){
+        err(EXIT_FAILURE, "Cannot allocate the thread counters");
+    }
+#ifdef TYPE_PROFILE
+    profile_init(&b->profile);
+#endif
+
+    pthread_once(&blocksOnce, block_key_init);
+    pthread_setspecific(blocksKey, b);
+
+    pthread_mutex_lock(&blocksLock);
+    b->next = threadBlocks;
+    threadBlocks = b;
+    pthread_mutex_unlock(&blocksLock);
+
+    threadBlock = b;
+    return b;
+}/* block_create */
+
+static inline
+struct ThreadBlock *thread_block(void)
+{
+    struct ThreadBlock *b = threadBlock;
+
+    return __builtin_expect(b != NULL, 1) ? b : block_create();
+}/* thread_block */
+#endif
+
+#ifdef TYPE_STATS
+/* the failures are rare, only the ops counter is written on TS_OK */
+static inline
+void stats_count(enum TypeStatOp op, int type, enum TypeStatus st)
+{
+    struct ThreadBlock *b = thread_block();
+
+    if ((unsigned)type >= TYPE_STATS_TYPES){
+        return;
+    }
+
+    struct TypeStat *s = &b->stats.stat[type][op];
+
+    stat_add(&s->ops, 1);
+    if (__builtin_expect(st != TS_OK, 0)){
+        stat_add((st == TS_OUTRANGE) ? &s->outrange : &s->incompatible, 1);
+    }
+}/* stats_count */
+
+/* a batch of n operations, counted once */
+static inline
+void stats_count_n(enum TypeStatOp op, int type, int n, int outrange,
+                   int incompatible)
+{
+    struct ThreadBlock *b = thread_block();
+
+    if ((unsigned)type >= TYPE_STATS_TYPES || n <= 0){
+        return;
+    }
+
+    struct TypeStat *s = &b->stats.stat[type][op];
+
+    stat_add(&s->ops, (unsigned long long)n);
+    if (__builtin_expect(outrange != 0, 0)){
+        stat_add(&s->outrange, (unsigned long long)outrange);
+    }
+    if (__builtin_expect(incompatible != 0, 0)){
+        stat_add(&s->incompatible, (unsigned long long)incompatible);
+    }
+}/* stats_count_n */
+
+#define STATS_COUNT(op, type, st) stats_count((op), (type), (st))
+#define STATS_COUNT_N(op, type, n, outrange, incompatible) \
+    stats_count_n((op), (type), (n), (outrange), (incompatible))
+#else
+#define STATS_COUNT(op, type, st) ((void)0)
+/* op is often a parameter of the caller */
+#define STATS_COUNT_N(op, type, n, outrange, incompatible) ((void)(op))
+#endif
+
+#ifdef TYPE_PROFILE
+#ifdef NDEBUG
+#define PROF_ASSERTS    0
+#else
+#define PROF_ASSERTS    1
+#endif
+
+static const char *PROF_NAME[TYPE_PROF_ALL] = {
+    [TYPE_PROF_SETI] = "seti",
+    [TYPE_PROF_SETD] = "setd",
+    [TYPE_PROF_SETDS] = "setds",
+    [TYPE_PROF_SETDEC] = "setdec",
+    [TYPE_PROF_SETN] = "setn",
+    [TYPE_PROF_PARSE] = "parse",
+    [TYPE_PROF_PARSE_N] = "parse_n",
+    [TYPE_PROF_FLOAT] = "float",
+    [TYPE_PROF_STR] = "str",
+    [TYPE_PROF_STR_N] = "str_n",
+    [TYPE_PROF_SUM] = "sum",
+    [TYPE_PROF_MUL] = "mul",
+    [TYPE_PROF_DIV] = "div",
+    [TYPE_PROF_SUM_SAT] = "sum_sat",
+    [TYPE_PROF_MUL_SAT] = "mul_sat",
+    [TYPE_PROF_FMA] = "fma",
+    [TYPE_PROF_LERP] = "lerp",
+    [TYPE_PROF_CLAMP_ADD] = "clamp_add",
+    [TYPE_PROF_CONVERT] = "convert",
+    [TYPE_PROF_ACC] = "acc",
+    [TYPE_PROF_ACC_N] = "acc_n",
+    [TYPE_PROF_SUM_N] = "sum_n",
+    [TYPE_PROF_MUL_N] = "mul_n",
+    [TYPE_PROF_DIV_N] = "div_n",
+    [TYPE_PROF_SUM_SAT_N] = "sum_sat_n",
+    [TYPE_PROF_MUL_SAT_N] = "mul_sat_n",
+    [TYPE_PROF_FMA_N] = "fma_n",
+    [TYPE_PROF_CONVERT_N] = "convert_n",
+    [TYPE_PROF_PACK] = "pack",
+    [TYPE_PROF_UNPACK] = "unpack",
+    [TYPE_PROF_PACK_N] = "pack_n",
+    [TYPE_PROF_UNPACK_N] = "unpack_n",
+    [TYPE_PROF_PACK_SUM] = "pack_sum",
+    [TYPE_PROF_PACK_MUL] = "pack_mul",
+    [TYPE_PROF_PACK_DIV] = "pack_div",
+    [TYPE_PROF_COLUMN_SET] = "column_set",
+    [TYPE_PROF_COLUMN_PARSE] = "column_parse",
+    [TYPE_PROF_COLUMN_SUM] = "column_sum",
+    [TYPE_PROF_COLUMN_MUL] = "column_mul",
+    [TYPE_PROF_COLUMN_DIV] = "column_div",
+    [TYPE_PROF_COLUMN_SUM_SAT] = "column_sum_sat",
+    [TYPE_PROF_COLUMN_CONVERT] = "column_convert",
+    [TYPE_PROF_COLUMN_VALIDATE] = "column_validate",
+    [TYPE_PROF_COLUMN_CLAMP] = "column_clamp",
+    [TYPE_PROF_NARROW_SET] = "narrow_set",
+    [TYPE_PROF_NARROW_SUM] = "narrow_sum",
+    [TYPE_PROF_NARROW_MUL] = "narrow_mul",
+    [TYPE_PROF_NARROW_DIV] = "narrow_div",
+    [TYPE_PROF_NARROW_VALIDATE] = "narrow_validate",
+    [TYPE_PROF_REDUCE_N] = "reduce_n",
+    [TYPE_PROF_COLUMN_REDUCE] = "column_reduce",
+    [TYPE_PROF_COLUMN_REDUCE_MT] = "column_reduce_mt",
+    [TYPE_PROF_COUNT_N] = "count_n",
+    [TYPE_PROF_COLUMN_COUNT] = "column_count",
+    [TYPE_PROF_RING_PUSH_N] = "ring_push_n",
+    [TYPE_PROF_RING_POP_N] = "ring_pop_n",
+    [TYPE_PROF_RING_PUSH_PACKED_N] = "ring_push_packed_n",
+    [TYPE_PROF_RING_POP_PACKED_N] = "ring_pop_packed_n",
+    [TYPE_PROF_RING_POP_COLUMN] = "ring_pop_column",
+    [TYPE_PROF_STALE_TOUCH] = "stale_touch",
+    [TYPE_PROF_STALE_PUT] = "stale_put",
+    [TYPE_PROF_STALE_PUT_N] = "stale_put_n",
+    [TYPE_PROF_STALE_QUERY] = "stale_query"
+};
+
+static const char *PROF_CATEGORY[TYPE_PROF_CATEGORIES] = {
+    "NOMINAL", "INTEGER", "DECIMAL", "NONE"
+};
+
+static inline
+unsigned long long prof_clock(void)
+{
+#ifdef PROF_TSC
+    return __rdtsc();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL +
+           (unsigned long long)ts.tv_nsec;
+#endif
+}/* prof_clock */
+
+/* 0..3 are exact, then 4 buckets for every power of two */
+static inline
+int prof_bucket(unsigned long long v)
+{
+    if (v < 4){
+        return (int)v;
+    }
+
+    int e = 63 - __builtin_clzll(v);
+    int i = (e - 1) * 4 + (int)((v >> (e - 2)) & 3);
+
+    return (i < TYPE_PROF_BUCKETS) ? i : TYPE_PROF_BUCKETS - 1;
+}/* prof_bucket */
+
+/* the first value of the bucket */
+static
+unsigned long long prof_lower(int i)
+{
+    if (i < 4){
+        return (unsigned long long)i;
+    }
+
+    int e = i / 4 + 1;
+    return (unsigned long long)(4 + i % 4) << (e - 2);
+}/* prof_lower */
+
+static
+void profile_init(struct TypeProfile *p)
+{
+    memset(p, 0, sizeof(struct TypeProfile));
+    p->asserts = PROF_ASSERTS;
+#ifdef PROF_TSC
+    p->ns = 0;
+#else
+    p->ns = 1;
+#endif
+}/* profile_init */
+
+/* calls of the current thread before the next sample */
+static __thread unsigned profSkip = 0;
+
+/* the start time, 0 if the call is not sampled */
+static inline
+unsigned long long prof_start(void)
+{
+    if (profSkip > 0){
+        profSkip--;
+        return 0;
+    }
+
+    profSkip = TYPE_PROFILE_PERIOD - 1;
+    return prof_clock();
+}/* prof_start */
+
+/* A measured scope, the sample is taken when it goes out of scope (the
+ * cleanup attribute), so every return of the function is measured.
+ */
+struct ProfScope {
+    enum TypeProfOp op;
+    int type;
+    unsigned long long start;
+};
+
+static
+void prof_end(const struct ProfScope *s)
+{
+    if (s->start == 0){
+        return;
+    }
+
+    const unsigned long long t = prof_clock() - s->start;
+    const struct TypeTable *tt = type_table();
+    const int category = (s->type >= 0 && s->type < tt->len)
+                       ? (int)tt->desc[s->type].category
+                       : TYPE_PROF_CATEGORIES - 1;
+    struct TypeProfHist *h = &thread_block()->profile.hist[s->op][category];
+
+    stat_add(&h->count, 1);
+    stat_add(&h->total, t);
+    stat_add(&h->bucket[prof_bucket(t)], 1);
+}/* prof_end */
+
+#define PROFILE(op, type) \
+    const struct ProfScope profScope __attribute__((cleanup(prof_end))) = \
+        {(op), (type), prof_start()}
+#else
+#define PROFILE(op, type) ((void)0)
+#endif
 
 static
-bool validate_type(int type)
+bool validate_type(const struct TypeTable *tt, int type)
 {
-    return (type >= 0) && (type < configLen);
+    return (type >= 0) && (type < tt->len);
 }
 
+static inline
+bool store_in_range(const struct TypeDesc *c, type_value_store v)
+{
+    return (v >= c->rangeMin) && (v <= c->rangeMax);
+}
+
+/* Saturation of a result to [min, max], without branches.
+ * On overflow v is not meaningful and negative tells the side of the
+ * exact result.
+ */
+static inline
+type_value_store sat_clamp(type_value_store v, bool overflow, bool negative,
+                           type_value_store min, type_value_store max,
+                           bool *sat)
+{
+    type_value_store limit = negative ? min : max;
+    type_value_store clamped = (v < min) ? min : ((v > max) ? max : v);
+
+    *sat = overflow | (v < min) | (v > max);
+    return overflow ? limit : clamped;
+}/* sat_clamp */
+
+/* v / d truncated toward zero, without the hardware division.
+ * inv is floor((2^64 - 1) / d): the estimate with the reciprocal is the
+ * quotient or one less.
+ */
+static inline
+type_value_store recip_div(type_value_store v, type_value_store d,
+                           unsigned long long inv)
+{
+#ifdef TYPE_WIDE
+    const unsigned long long ud = (unsigned long long)d;
+    unsigned long long u = (v < 0) ? 0ULL - (unsigned long long)v
+                                   : (unsigned long long)v;
+    unsigned long long q = (unsigned long long)(((type_uwide)u * inv) >> 64);
+
+    q += (u - q * ud) >= ud;
+
+    return (v < 0) ? (type_value_store)(0ULL - q) : (type_value_store)q;
+#else
+    (void)inv;
+    return v / d;
+#endif
+}/* recip_div */
+
+/* v / cut truncated toward zero */
+static inline
+type_value_store desc_div(const struct TypeDesc *c, type_value_store v)
+{
+    return recip_div(v, c->cut, c->cutInv);
+}/* desc_div */
+
+/* remove the rightmost digits beyond the precision */
+static inline
+type_value_store desc_cut(const struct TypeDesc *c, type_value_store v)
+{
+    return desc_div(c, v) * c->cut;
+}/* desc_cut */
+
 static
-bool validate_range(const TypeValue tv)
+bool validate_range(const struct TypeTable *tt, const TypeValue tv)
 {
-    return (tv.value >= config[tv.type].rangeMin) &&
-           (tv.value <= config[tv.type].rangeMax);
+    return store_in_range(&tt->desc[tv.type], tv.value);
 }
 
 #ifndef NDEBUG
 static
-bool validate_value(const TypeValue tv)
+bool validate_value(const struct TypeTable *tt, const TypeValue tv)
+{
+    return validate_type(tt, tv.type) && validate_range(tt, tv);
+}
+
+static
+bool validate_packed(const struct TypeTable *tt, type_packed p)
 {
-    return validate_type(tv.type) && validate_range(tv);
+    const int type = (int)(p & PACK_TYPE_MASK);
+
+    return validate_type(tt, type) && tt->desc[type].packable &&
+           store_in_range(&tt->desc[type],
+                          (type_value_store)p >> TYPE_PACK_TYPE_BITS);
 }
 
 static
@@ -95,8 +606,12 @@ type_decimal type_dec(double v)
     return v * TYPE_DECIMAL_POWER;
 }
 
-void type_config(const struct TypeConf *table, int len)
+/* compile the configuration in a new table */
+static
+struct TypeTable *table_compile(const struct TypeConf *table, int len)
 {
+    assert(len >= 0);
+
     /* sanity checks */
     for (int i=0; i < len; i++){
         assert(table[i].category >= 0);
@@ -111,14 +626,239 @@ void type_config(const struct TypeConf *table, int len)
                (table[i].category == DECIMAL && table[i].precision > 0));
     }
 
-    /* set globals */
-    config = table;
-    configLen = len;
+    struct TypeTable *tt = malloc(sizeof(struct TypeTable) +
+                                  sizeof(struct TypeDesc) * len);
+    if (tt == NULL){
+        err(EXIT_FAILURE, "Cannot allocate the type configuration");
+    }
+
+    tt->len = len;
+
+    for (int i=0; i < len; i++){
+        struct TypeDesc *d = &tt->desc[i];
+        type_value_store cut = 1;
+
+        if (table[i].category == DECIMAL){
+            for (int p=table[i].precision; p < TYPE_DECIMAL_DIGITS; p++){
+                cut *= 10;
+            }
+        }
+
+        d->rangeMin = table[i].rangeMin;
+        d->rangeMax = table[i].rangeMax;
+        d->cut = cut;
+        d->cutInv = ~0ULL / (unsigned long long)cut;
+        d->category = table[i].category;
+        d->precision = table[i].precision;
+        d->packable = ((unsigned long long)i <= PACK_TYPE_MASK) &&
+                      (d->rangeMin >= PACK_MIN) && (d->rangeMax <= PACK_MAX);
+    }
+
+    return tt;
+}/* table_compile */
+
+static
+void table_free(struct TypeTable *tt)
+{
+    if (tt != &emptyTable){
+        free(tt);
+    }
+}/* table_free */
+
+void type_config(const struct TypeConf *table, int len)
+{
+    type_context_config(NULL, table, len);
 }/* type_config */
 
+/* FNV-1a of v as 8 bytes, least significant first */
+static
+unsigned long long hash_add(unsigned long long h, unsigned long long v)
+{
+    for (int i=0; i < 8; i++){
+        h ^= (v >> (8 * i)) & 0xff;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}/* hash_add */
+
+int type_config_len(void)
+{
+    return type_table()->len;
+}/* type_config_len */
+
+unsigned long long type_config_hash(void)
+{
+    const struct TypeTable *tt = type_table();
+    unsigned long long h = 0xcbf29ce484222325ULL;
+
+    h = hash_add(h, TYPE_DECIMAL_DIGITS);
+    h = hash_add(h, (unsigned long long)tt->len);
+    for (int i=0; i < tt->len; i++){
+        const struct TypeDesc *d = &tt->desc[i];
+
+        h = hash_add(h, (unsigned long long)d->category);
+        h = hash_add(h, (unsigned long long)d->rangeMin);
+        h = hash_add(h, (unsigned long long)d->rangeMax);
+        h = hash_add(h, (unsigned long long)d->precision);
+    }
+
+    return h;
+}/* type_config_hash */
+
+int type_valid(const TypeValue tv)
+{
+    const struct TypeTable *tt = type_table();
+
+    return validate_type(tt, tv.type) && validate_range(tt, tv);
+}/* type_valid */
+
+TypeContext *type_context_new(const struct TypeConf *table, int len)
+{
+    TypeContext *ctx = malloc(sizeof(TypeContext));
+    if (ctx == NULL){
+        err(EXIT_FAILURE, "Cannot allocate the type context");
+    }
+
+    ctx->table = &emptyTable;
+    type_context_config(ctx, table, len);
+
+    return ctx;
+}/* type_context_new */
+
+void type_context_free(TypeContext *ctx)
+{
+    assert(ctx != NULL);
+    assert(ctx != &defaultContext);
+    assert(ctx != boundContext);
+
+    table_free(ctx->table);
+    free(ctx);
+}/* type_context_free */
+
+void type_thread_online(void)
+{
+    assert(reader.period == 0);
+
+    pthread_mutex_lock(&graceLock);
+    reader.next = readers;
+    readers = &reader;
+    __atomic_store_n(&reader.period, gracePeriod, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&graceLock);
+}/* type_thread_online */
+
+void type_thread_offline(void)
+{
+    assert(reader.period != 0);
+
+    /* before the lock: a writer may be waiting for this thread */
+    __atomic_store_n(&reader.period, 0, __ATOMIC_RELEASE);
+
+    pthread_mutex_lock(&graceLock);
+    struct TypeReader **r = &readers;
+    while (*r != &reader){
+        r = &(*r)->next;
+    }
+    *r = reader.next;
+    reader.next = NULL;
+    pthread_mutex_unlock(&graceLock);
+}/* type_thread_offline */
+
+void type_quiescent(void)
+{
+    assert(reader.period != 0);
+
+    unsigned long period = __atomic_load_n(&gracePeriod, __ATOMIC_ACQUIRE);
+    __atomic_store_n(&reader.period, period, __ATOMIC_RELEASE);
+}/* type_quiescent */
+
+/* Start a new period and wait for all the online threads, graceLock held.
+ * The calling thread is not inside an operation, so it is not waited.
+ */
+static
+void grace_wait(void)
+{
+    unsigned long period = __atomic_add_fetch(&gracePeriod, 1,
+                                              __ATOMIC_SEQ_CST);
+
+    for (struct TypeReader *r = readers; r != NULL; r = r->next){
+        if (r == &reader){
+            continue;
+        }
+
+        unsigned long seen = __atomic_load_n(&r->period, __ATOMIC_ACQUIRE);
+        while (seen != 0 && seen != period){
+            sched_yield();
+            seen = __atomic_load_n(&r->period, __ATOMIC_ACQUIRE);
+        }
+    }
+}/* grace_wait */
+
+/* Take graceLock. An online caller is quiescent (period 0) until
+ * grace_unlock(): another writer can hold the lock and wait for it.
+ * Return the period of the caller, 0 if offline.
+ */
+static
+unsigned long grace_lock(void)
+{
+    const unsigned long period = reader.period;
+
+    if (period != 0){
+        __atomic_store_n(&reader.period, 0, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_lock(&graceLock);
+
+    return period;
+}/* grace_lock */
+
+/* release graceLock, an online caller is back in the current period */
+static
+void grace_unlock(unsigned long period)
+{
+    pthread_mutex_unlock(&graceLock);
+
+    if (period != 0){
+        period = __atomic_load_n(&gracePeriod, __ATOMIC_ACQUIRE);
+        __atomic_store_n(&reader.period, period, __ATOMIC_RELEASE);
+    }
+}/* grace_unlock */
+
+void type_synchronize(void)
+{
+    unsigned long period = grace_lock();
+    grace_wait();
+    grace_unlock(period);
+}/* type_synchronize */
+
+void type_context_config(TypeContext *ctx, const struct TypeConf *table,
+                         int len)
+{
+    if (ctx == NULL){
+        ctx = &defaultContext;
+    }
+
+    struct TypeTable *tt = table_compile(table, len);
+
+    unsigned long period = grace_lock();
+
+    /* the readers see either the old or the new table, never a mix */
+    struct TypeTable *old = __atomic_exchange_n(&ctx->table, tt,
+                                                __ATOMIC_ACQ_REL);
+    grace_wait();
+    grace_unlock(period);
+
+    table_free(old);
+}/* type_context_config */
+
+TypeContext *type_context_use(TypeContext *ctx)
+{
+    TypeContext *prev = boundContext;
+    boundContext = ctx;
+    return prev;
+}/* type_context_use */
+
 TypeValue type_init(int type)
 {
-    assert(validate_type(type));
+    assert(validate_type(type_table(), type));
 
     TypeValue t = {.type = type, .value = 0};
 #ifdef TYPE_TIMESTAMP
@@ -129,95 +869,168 @@ TypeValue type_init(int type)
 
 int type_type(const TypeValue tv)
 {
-    assert(validate_type(tv.type));
+    assert(validate_type(type_table(), tv.type));
     return tv.type;
 }/* type_type */
 
 type_value_store type_int(const TypeValue tv)
 {
-    assert(validate_value(tv));
+    assert(validate_value(type_table(), tv));
     return tv.value;
 }/* type_int */
 
 double type_float(const TypeValue tv)
 {
-    assert(validate_value(tv));
+    PROFILE(TYPE_PROF_FLOAT, tv.type);
+
+    assert(validate_value(type_table(), tv));
     return ((double)(tv.value)) / (double)TYPE_DECIMAL_POWER;
 }/* type_float */
 
 int type_nom(const TypeValue tv)
 {
-    assert(validate_value(tv));
+    assert(validate_value(type_table(), tv));
     return tv.value;
 }/* type_nom */
 
 TypeResult type_seti(const TypeValue tv, type_value_store v)
 {
+    PROFILE(TYPE_PROF_SETI, tv.type);
+
+    const struct TypeTable *tt = type_table();
+
     TypeValue t = {.type = tv.type, .value = v};
 #ifdef TYPE_TIMESTAMP
-    t.timestamp = type_now();
+    t.timestamp = type_stamp();
 #endif
     TypeResult res = {.status = TS_OK, .out = t};
 
-    if ((validate_type(tv.type)) &&
-        (config[tv.type].category != INTEGER)){
+    if ((validate_type(tt, tv.type)) &&
+        (tt->desc[tv.type].category != INTEGER)){
         res.status = TS_INCOMPATIBLE;
+        STATS_COUNT(TYPE_OP_SETI, tv.type, res.status);
         return res;
     }
 
-    if (!validate_range(t)){
+    if (!validate_range(tt, t)){
         res.status = TS_OUTRANGE;
+        STATS_COUNT(TYPE_OP_SETI, tv.type, res.status);
         return res;
     }
 
+    STATS_COUNT(TYPE_OP_SETI, tv.type, res.status);
     return res;
 }/* type_seti */
 
 TypeResult type_setd(const TypeValue tv, double val)
 {
-    type_value_store v = type_dec(val);
+    PROFILE(TYPE_PROF_SETD, tv.type);
+
+    return type_setds(tv, type_dec(val));
+}/* type_setd */
+
+/* type_setds without the counting */
+static
+TypeResult decimal_set(const TypeValue tv, type_decimal v)
+{
+    const struct TypeTable *tt = type_table();
 
     /* enforce precision */
-    int prec = config[tv.type].precision;
-    type_value_store cut = exp10((double)(TYPE_DECIMAL_DIGITS - prec));
-    v = (v / cut) * cut; /* integer operations, remove righmost digits */
+    v = desc_cut(&tt->desc[tv.type], v); /* integer operations, remove righmost digits */
 
     TypeValue t = {.type = tv.type, .value = v};
 #ifdef TYPE_TIMESTAMP
-    t.timestamp = type_now();
+    t.timestamp = type_stamp();
 #endif
     TypeResult res = {.status = TS_OK, .out = t};
 
-    if ((validate_type(tv.type)) &&
-        (config[tv.type].category != DECIMAL)){
+    if ((validate_type(tt, tv.type)) &&
+        (tt->desc[tv.type].category != DECIMAL)){
         res.status = TS_INCOMPATIBLE;
         return res;
     }
 
 
-    if (!validate_range(t)){
+    if (!validate_range(tt, t)){
         res.status = TS_OUTRANGE;
         return res;
     }
 
     return res;
-}/* type_setd */
+}/* decimal_set */
+
+TypeResult type_setds(const TypeValue tv, type_decimal v)
+{
+    PROFILE(TYPE_PROF_SETDS, tv.type);
+
+    TypeResult res = decimal_set(tv, v);
+
+    STATS_COUNT(TYPE_OP_SETD, tv.type, res.status);
+    return res;
+}/* type_setds */
+
+/* powers of ten that fit in the store */
+static const type_value_store POW10[] = {
+    1LL, 10LL, 100LL, 1000LL, 10000LL, 100000LL, 1000000LL, 10000000LL,
+    100000000LL, 1000000000LL, 10000000000LL, 100000000000LL,
+    1000000000000LL, 10000000000000LL, 100000000000000LL,
+    1000000000000000LL, 10000000000000000LL, 100000000000000000LL,
+    1000000000000000000LL
+};
+#define POW10_MAX   18
+
+TypeResult type_setdec(const TypeValue tv, long long mantissa, int exp10)
+{
+    PROFILE(TYPE_PROF_SETDEC, tv.type);
+
+    /* shift to the internal precision, an exponent beyond the table gives
+     * the same result as the first one out of it (no int overflow)
+     */
+    if (exp10 > POW10_MAX + 1){
+        exp10 = POW10_MAX + 1;
+    } else if (exp10 < -2 * POW10_MAX - 1){
+        exp10 = -2 * POW10_MAX - 1;
+    }
+    int shift = TYPE_DECIMAL_DIGITS + exp10;
+    type_value_store v = 0;
+    bool overflow = false;
+
+    if (shift >= 0){
+        overflow = (shift > POW10_MAX) ? (mantissa != 0)
+                 : __builtin_mul_overflow(mantissa, POW10[shift], &v);
+    } else if (-shift <= POW10_MAX){
+        v = mantissa / POW10[-shift]; /* truncation toward zero */
+    }
+
+    TypeResult res = decimal_set(tv, overflow ? 0 : v);
+
+    if (overflow && res.status == TS_OK){
+        res.status = TS_OUTRANGE;
+    }
+
+    STATS_COUNT(TYPE_OP_SETD, tv.type, res.status);
+    return res;
+}/* type_setdec */
 
 TypeResult type_setn(const TypeValue tv, int name)
 {
+    PROFILE(TYPE_PROF_SETN, tv.type);
+
+    const struct TypeTable *tt = type_table();
+
     TypeValue t = {.type = tv.type, .value = name};
 #ifdef TYPE_TIMESTAMP
-    t.timestamp = type_now();
+    t.timestamp = type_stamp();
 #endif
     TypeResult res = {.status = TS_OK, .out = t};
 
-    if ((validate_type(tv.type)) &&
-        (config[tv.type].category != NOMINAL)){
+    if ((validate_type(tt, tv.type)) &&
+        (tt->desc[tv.type].category != NOMINAL)){
         res.status = TS_INCOMPATIBLE;
         return res;
     }
 
-    if (!validate_range(t)){
+    if (!validate_range(tt, t)){
         res.status = TS_OUTRANGE;
         return res;
     }
@@ -225,52 +1038,341 @@ TypeResult type_setn(const TypeValue tv, int name)
     return res;
 }/* type_setn */
 
-/* for internal use only, no input validation needed,
- * valid for INTEGER and DECIMAL since the last one is represented as long too
+/* Parse [+-]digits[.digits] in the internal representation.
+ * The fraction is allowed only for DECIMAL, the digits beyond
+ * TYPE_DECIMAL_DIGITS are dropped (truncation).
+ * Return TS_INCOMPATIBLE for a malformed text, TS_OUTRANGE if the number
+ * does not fit in the store.
  */
 static
-TypeResult value_sum(const TypeValue a, const TypeValue b)
+enum TypeStatus parse_store(const char *str, int len, bool decimal,
+                            type_value_store *out)
 {
-    type_value_store va = a.value;
-    type_value_store vb = b.value;
-    type_value_store sum = 0;
-    enum TypeStatus status = TS_OK;
+    unsigned long long u = 0;
+    unsigned long long frac = 0;
+    bool neg = false;
+    bool overflow = false;
+    int digits = 0;
+    int i = 0;
 
-    //sum = va + vb;
-    if (__builtin_add_overflow(va, vb, &sum)){
-        status = TS_OUTRANGE;
-    }
+    *out = 0;
 
-    TypeValue t = {.type = a.type, .value = sum};
+    if (i < len && (str[i] == '-' || str[i] == '+')){
+        neg = (str[i] == '-');
+        i++;
+    }
 
-    if (!validate_range(t)){
-        status = TS_OUTRANGE;
+    for (; i < len && str[i] >= '0' && str[i] <= '9'; i++, digits++){
+        overflow |= __builtin_mul_overflow(u, 10ULL, &u);
+        overflow |= __builtin_add_overflow(u, (unsigned long long)(str[i] - '0'), &u);
     }
 
-    TypeResult res = {.status = status, .out = t};
+    if (decimal){
+        int fdigits = 0;
 
-    return res;
-}/* value_sum */
+        if (i < len && str[i] == '.'){
+            for (i++; i < len && str[i] >= '0' && str[i] <= '9'; i++, fdigits++){
+                if (fdigits < TYPE_DECIMAL_DIGITS){
+                    frac = frac * 10 + (unsigned long long)(str[i] - '0');
+                }
+            }
+        }
 
-TypeResult type_sum(const TypeValue a, const TypeValue b)
-{
-    assert(validate_value(a));
-    assert(validate_value(b));
+        digits += fdigits;
+        for (; fdigits < TYPE_DECIMAL_DIGITS; fdigits++){
+            frac *= 10;
+        }
 
-    TypeValue t = {.type = a.type, .value = 0};
+        overflow |= __builtin_mul_overflow(u, (unsigned long long)TYPE_DECIMAL_POWER, &u);
+        overflow |= __builtin_add_overflow(u, frac, &u);
+    }
+
+    if (i != len || digits == 0){
+        return TS_INCOMPATIBLE;
+    }
+
+    /* the negative range has one more value */
+    if (overflow || u > (unsigned long long)LLONG_MAX + neg){
+        return TS_OUTRANGE;
+    }
+
+    *out = neg ? (type_value_store)(0ULL - u) : (type_value_store)u;
+    return TS_OK;
+}/* parse_store */
+
+/* parse, enforce the precision and check the range */
+static inline
+enum TypeStatus parse_value(const struct TypeDesc *c, const char *str, int len,
+                            type_value_store *out)
+{
+    enum TypeStatus status = parse_store(str, len, c->category == DECIMAL, out);
+
+    if (status != TS_OK){
+        return status;
+    }
+
+    if (c->category == DECIMAL){
+        *out = desc_cut(c, *out);
+    }
+
+    return store_in_range(c, *out) ? TS_OK : TS_OUTRANGE;
+}/* parse_value */
+
+TypeResult type_parse(const TypeValue tv, const char *str, int len)
+{
+    PROFILE(TYPE_PROF_PARSE, tv.type);
+
+    const struct TypeTable *tt = type_table();
+
+    assert(validate_type(tt, tv.type));
+    assert(str != NULL);
+
+    TypeValue t = {.type = tv.type, .value = 0};
+#ifdef TYPE_TIMESTAMP
+    t.timestamp = type_stamp();
+#endif
+    TypeResult res = {.status = TS_OK, .out = t};
+
+    res.status = parse_value(&tt->desc[tv.type], str, len, &res.out.value);
+
+    return res;
+}/* type_parse */
+
+/* the next field of text, without the blanks around it.
+ * Return the position after the separator.
+ */
+static inline
+int parse_field(const char *text, int pos, int len, char sep,
+                const char **field, int *flen)
+{
+    const char *end = memchr(text + pos, sep, len - pos);
+    int next = (end == NULL) ? len : (int)(end - text) + 1;
+    int stop = (end == NULL) ? len : (int)(end - text);
+
+    while (pos < stop && (text[pos] == ' ' || text[pos] == '\t')){
+        pos++;
+    }
+    while (stop > pos && (text[stop - 1] == ' ' || text[stop - 1] == '\t' ||
+                          text[stop - 1] == '\r' || text[stop - 1] == '\n')){
+        stop--;
+    }
+
+    *field = text + pos;
+    *flen = stop - pos;
+
+    return next;
+}/* parse_field */
+
+int type_parse_n(TypeValue *out, enum TypeStatus *status, int type,
+                 const char *text, int len, char sep, int n)
+{
+    PROFILE(TYPE_PROF_PARSE_N, type);
+
+    const struct TypeTable *tt = type_table();
+
+    assert(validate_type(tt, type));
+    assert(text != NULL);
+
+    const struct TypeDesc *c = &tt->desc[type];
+    int pos = 0;
+    int count = 0;
+#ifdef TYPE_TIMESTAMP
+    const type_millisecs now = type_stamp();
+#endif
+
+    while (pos < len && count < n){
+        const char *field = NULL;
+        int flen = 0;
+
+        pos = parse_field(text, pos, len, sep, &field, &flen);
+
+        out[count].type = type;
+#ifdef TYPE_TIMESTAMP
+        out[count].timestamp = now;
+#endif
+        status[count] = parse_value(c, field, flen, &out[count].value);
+        count++;
+    }
+
+    return count;
+}/* type_parse_n */
+
+/* Kernels on the raw stores.
+ * For internal use only, no input validation needed.
+ * They are shared by the single value and the batch operations, so the
+ * results are the same in both cases.
+ */
+
+typedef enum TypeStatus (*store_kernel)(const struct TypeDesc *,
+                                        type_value_store, type_value_store,
+                                        type_value_store *);
+
+/* valid for INTEGER and DECIMAL since the last one is represented as long too */
+static inline
+enum TypeStatus store_sum(const struct TypeDesc *c, type_value_store va,
+                          type_value_store vb, type_value_store *out)
+{
+    //*out = va + vb;
+    bool overflow = __builtin_add_overflow(va, vb, out);
+    return (overflow || !store_in_range(c, *out)) ? TS_OUTRANGE : TS_OK;
+}/* store_sum */
+
+static inline
+enum TypeStatus store_imul(const struct TypeDesc *c, type_value_store va,
+                           type_value_store vb, type_value_store *out)
+{
+    //*out = va * vb;
+    bool overflow = __builtin_mul_overflow(va, vb, out);
+    return (overflow || !store_in_range(c, *out)) ? TS_OUTRANGE : TS_OK;
+}/* store_imul */
+
+/* mul = va * vb / POWER truncated, return true on overflow */
+static inline
+bool dmul_raw(type_value_store va, type_value_store vb, type_value_store *mul)
+{
+    if (!__builtin_mul_overflow(va, vb, mul)){
+        /* common case, division by a constant */
+        *mul = *mul / TYPE_DECIMAL_POWER;
+        return false;
+    }
+
+    /* the product does not fit, but the result can */
+#ifdef TYPE_WIDE
+    type_wide wide = ((type_wide)va * vb) / TYPE_DECIMAL_POWER;
+    *mul = (type_value_store)wide;
+    return ((type_wide)*mul != wide);
+#else
+    /* va = q * POWER + r, r has the sign of va, so the two terms have the
+     * same sign and the truncation of the sum is the sum of the truncations.
+     */
+    type_value_store q = va / TYPE_DECIMAL_POWER;
+    type_value_store r = va % TYPE_DECIMAL_POWER;
+    type_value_store hi = 0;
+    type_value_store lo = 0;
+
+    return __builtin_mul_overflow(q, vb, &hi) ||
+           __builtin_mul_overflow(r, vb, &lo) ||
+           __builtin_add_overflow(hi, lo / TYPE_DECIMAL_POWER, mul);
+#endif
+}/* dmul_raw */
+
+static inline
+enum TypeStatus store_dmul(const struct TypeDesc *c, type_value_store va,
+                           type_value_store vb, type_value_store *out)
+{
+    //*out = va * vb / POWER;
+    bool overflow = dmul_raw(va, vb, out);
+    return (overflow || !store_in_range(c, *out)) ? TS_OUTRANGE : TS_OK;
+}/* store_dmul */
+
+/* the divisor must not be zero */
+static inline
+enum TypeStatus store_ddiv(const struct TypeDesc *c, type_value_store va,
+                           type_value_store vb, type_value_store *out)
+{
+    type_value_store num = 0;
+    type_value_store div = 0;
+    bool overflow = false;
+
+    //div = va * POWER / vb;
+    if (!__builtin_mul_overflow(va, (type_value_store)TYPE_DECIMAL_POWER, &num) &&
+        !(num == LLONG_MIN && vb == -1)){
+        div = num / vb;
+    } else {
+#ifdef TYPE_WIDE
+        type_wide wide = ((type_wide)va * TYPE_DECIMAL_POWER) / vb;
+        div = (type_value_store)wide;
+        overflow = ((type_wide)div != wide);
+#else
+        long double ld = ((long double)va / (long double)vb) * TYPE_DECIMAL_POWER;
+        overflow = (ld >= 0x1p63L) || (ld < -0x1p63L);
+        div = overflow ? 0 : (type_value_store)ld;
+#endif
+    }
+
+    /* enforce precision */
+    *out = desc_cut(c, div); /* integer operations, remove righmost digits */
+
+    return (overflow || !store_in_range(c, *out)) ? TS_OUTRANGE : TS_OK;
+}/* store_ddiv */
+
+/* The saturating kernels: the result is always stored, clamped to the
+ * range, and TS_OUTRANGE marks the saturation.
+ */
+static inline
+enum TypeStatus store_sum_sat(const struct TypeDesc *c, type_value_store va,
+                              type_value_store vb, type_value_store *out)
+{
+    type_value_store v = 0;
+    bool overflow = __builtin_add_overflow(va, vb, &v);
+    bool sat = false;
+
+    *out = sat_clamp(v, overflow, vb < 0, c->rangeMin, c->rangeMax, &sat);
+    return sat ? TS_OUTRANGE : TS_OK;
+}/* store_sum_sat */
+
+static inline
+enum TypeStatus store_imul_sat(const struct TypeDesc *c, type_value_store va,
+                               type_value_store vb, type_value_store *out)
+{
+    type_value_store v = 0;
+    bool overflow = __builtin_mul_overflow(va, vb, &v);
+    bool sat = false;
+
+    *out = sat_clamp(v, overflow, (va < 0) != (vb < 0),
+                     c->rangeMin, c->rangeMax, &sat);
+    return sat ? TS_OUTRANGE : TS_OK;
+}/* store_imul_sat */
+
+static inline
+enum TypeStatus store_dmul_sat(const struct TypeDesc *c, type_value_store va,
+                               type_value_store vb, type_value_store *out)
+{
+    type_value_store v = 0;
+    bool overflow = dmul_raw(va, vb, &v);
+    bool sat = false;
+
+    *out = sat_clamp(v, overflow, (va < 0) != (vb < 0),
+                     c->rangeMin, c->rangeMax, &sat);
+    return sat ? TS_OUTRANGE : TS_OK;
+}/* store_dmul_sat */
+
+static
+TypeResult value_sum(const struct TypeDesc *c,
+                     const TypeValue a, const TypeValue b)
+{
+    TypeValue t = {.type = a.type, .value = 0};
+    TypeResult res = {.status = TS_OK, .out = t};
+
+    res.status = store_sum(c, a.value, b.value, &res.out.value);
+
+    return res;
+}/* value_sum */
+
+TypeResult type_sum(const TypeValue a, const TypeValue b)
+{
+    PROFILE(TYPE_PROF_SUM, a.type);
+
+    const struct TypeTable *tt = type_table();
+
+    assert(validate_value(tt, a));
+    assert(validate_value(tt, b));
+
+    TypeValue t = {.type = a.type, .value = 0};
     TypeResult res = {.status = TS_INCOMPATIBLE, .out = t};
 
     if (a.type != b.type){
+        STATS_COUNT(TYPE_OP_SUM, a.type, res.status);
         return res;
     }
 
-    switch (config[a.type].category){
+    switch (tt->desc[a.type].category){
     case NOMINAL:
         res.status = TS_INCOMPATIBLE;
         break;
     case INTEGER: /* fall through */
     case DECIMAL:
-        res = value_sum(a, b);
+        res = value_sum(&tt->desc[a.type], a, b);
         break;
     default:
         errx(EXIT_FAILURE, "Invalid category configuration for type: %i", a.type);
@@ -279,84 +1381,64 @@ TypeResult type_sum(const TypeValue a, const TypeValue b)
 
 
 #ifdef TYPE_TIMESTAMP
-    res.out.timestamp = type_now();
+    res.out.timestamp = type_stamp();
 #endif
+    STATS_COUNT(TYPE_OP_SUM, a.type, res.status);
     return res;
 } /* type_sum */
 
 /* for internal use only, no input validation needed */
 static
-TypeResult integer_mul(const TypeValue a, const TypeValue b)
+TypeResult integer_mul(const struct TypeDesc *c,
+                       const TypeValue a, const TypeValue b)
 {
-    type_value_store va = a.value;
-    type_value_store vb = b.value;
-    type_value_store mul = 0;
-    enum TypeStatus status = TS_OK;
-
-    //mul = va * vb;
-    if (__builtin_mul_overflow(va, vb, &mul)){
-        status = TS_OUTRANGE;
-    }
-
-    TypeValue t = {.type = a.type, .value = mul};
-
-    if (!validate_range(t)){
-        status = TS_OUTRANGE;
-    }
+    TypeValue t = {.type = a.type, .value = 0};
+    TypeResult res = {.status = TS_OK, .out = t};
 
-    TypeResult res = {.status = status, .out = t};
+    res.status = store_imul(c, a.value, b.value, &res.out.value);
 
     return res;
 }/* integer_mul */
 
 /* for internal use only, no input validation needed */
 static
-TypeResult decimal_mul(const TypeValue a, const TypeValue b)
+TypeResult decimal_mul(const struct TypeDesc *c,
+                       const TypeValue a, const TypeValue b)
 {
-    type_value_store va = a.value;
-    type_value_store vb = b.value;
-    type_value_store mul = 0;
-    enum TypeStatus status = TS_OK;
-
-    //mul = va * vb / POWER;
-    if (__builtin_mul_overflow(va, vb, &mul)){
-        status = TS_OUTRANGE;
-    }
-
-    mul = mul / TYPE_DECIMAL_POWER;
-
-    TypeValue t = {.type = a.type, .value = mul};
-
-    if (!validate_range(t)){
-        status = TS_OUTRANGE;
-    }
+    TypeValue t = {.type = a.type, .value = 0};
+    TypeResult res = {.status = TS_OK, .out = t};
 
-    TypeResult res = {.status = status, .out = t};
+    res.status = store_dmul(c, a.value, b.value, &res.out.value);
 
     return res;
 }/* decimal_mul */
 
 TypeResult type_mul(const TypeValue a, const TypeValue b)
 {
-    assert(validate_value(a));
-    assert(validate_value(b));
+    PROFILE(TYPE_PROF_MUL, a.type);
+
+    const struct TypeTable *tt = type_table();
+
+    assert(validate_value(tt, a));
+    assert(validate_value(tt, b));
 
     TypeValue t = {.type = a.type, .value = 0};
     TypeResult res = {.status = TS_INCOMPATIBLE, .out = t};
 
     if (a.type != b.type){
+        STATS_COUNT(TYPE_OP_MUL, a.type, res.status);
         return res;
     }
 
-    switch (config[a.type].category){
+    switch (tt->desc[a.type].category){
     case NOMINAL:
         res.status = TS_INCOMPATIBLE;
         break;
     case INTEGER:
-        res = integer_mul(a, b);
+        res = integer_mul(&tt->desc[a.type], a, b);
         break;
     case DECIMAL:
-        res = decimal_mul(a, b);
+        res = decimal_mul(&tt->desc[a.type], a, b);
         break;
     default:
         errx(EXIT_FAILURE, "Invalid category configuration for type: %i", a.type);
@@ -364,67 +1446,193 @@ TypeResult type_mul(const TypeValue a, const TypeValue b)
     }/* switch */
 
 #ifdef TYPE_TIMESTAMP
-    res.out.timestamp = type_now();
+    res.out.timestamp = type_stamp();
 #endif
+    STATS_COUNT(TYPE_OP_MUL, a.type, res.status);
     return res;
 } /* type_mul */
 
+struct TypeAcc type_acc_init(void)
+{
+    struct TypeAcc acc = {.flags = 0, .first = TS_OK, .failed = -1,
+                          .count = 0};
+    return acc;
+}/* type_acc_init */
+
+/* record the status, without branches on it */
+static inline
+void acc_add(struct TypeAcc *acc, enum TypeStatus st)
+{
+    const bool fresh = (acc->failed < 0) & (st != TS_OK);
+
+    acc->flags |= (1u << st) & ~(1u << TS_OK);
+    acc->first = fresh ? st : acc->first;
+    acc->failed = fresh ? acc->count : acc->failed;
+    acc->count++;
+}/* acc_add */
+
+TypeValue type_acc(struct TypeAcc *acc, const TypeResult res)
+{
+    PROFILE(TYPE_PROF_ACC, res.out.type);
+
+    const struct TypeTable *tt = type_table();
+
+    assert(acc != NULL);
+    assert(validate_type(tt, res.out.type));
+
+    const struct TypeDesc *c = &tt->desc[res.out.type];
+    TypeValue out = res.out;
+    bool sat = false;
+
+    acc_add(acc, res.status);
+
+    /* a valid value for the next operation, the same if TS_OK */
+    out.value = sat_clamp(out.value, false, false, c->rangeMin, c->rangeMax,
+                          &sat);
+    return out;
+}/* type_acc */
+
+void type_acc_n(struct TypeAcc *acc, const enum TypeStatus *status, int n)
+{
+    PROFILE(TYPE_PROF_ACC_N, -1);
+
+    assert(acc != NULL);
+    assert(n >= 0);
+    assert(n == 0 || status != NULL);
+
+    for (int i=0; i < n; i++){
+        acc_add(acc, status[i]);
+    }
+}/* type_acc_n */
+
+/* the saturating operations for the category of a, NULL if none */
 static
-TypeResult decimal_div(const TypeValue a, const TypeValue b)
+store_kernel sat_select(const TypeValue a, const struct TypeDesc *c,
+                        store_kernel onInteger, store_kernel onDecimal)
 {
-    long double va = (long double)a.value;
-    long double vb = (long double)b.value;
-    type_value_store div = 0;
-    enum TypeStatus status = TS_OK;
+    switch (c->category){
+    case NOMINAL:
+        return NULL;
+    case INTEGER:
+        return onInteger;
+    case DECIMAL:
+        return onDecimal;
+    default:
+        errx(EXIT_FAILURE, "Invalid category configuration for type: %i", a.type);
+        break;
+    }/* switch */
 
-    div = (va / vb) * TYPE_DECIMAL_POWER;
+    return NULL;
+}/* sat_select */
 
-    /* enforce precision */
-    int prec = config[a.type].precision;
-    type_value_store cut = exp10((double)(TYPE_DECIMAL_DIGITS - prec));
-    div = (div / cut) * cut; /* integer operations, remove righmost digits */
+static
+TypeResult value_sat(const TypeValue a, const TypeValue b,
+                     store_kernel onInteger, store_kernel onDecimal)
+{
+    const struct TypeTable *tt = type_table();
+
+    assert(validate_value(tt, a));
+    assert(validate_value(tt, b));
 
-    TypeValue t = {.type = a.type, .value = div};
+    TypeValue t = {.type = a.type, .value = 0};
+    TypeResult res = {.status = TS_INCOMPATIBLE, .out = t};
+    const struct TypeDesc *c = &tt->desc[a.type];
+    store_kernel kernel = sat_select(a, c, onInteger, onDecimal);
 
-    if (!validate_range(t)){
-        status = TS_OUTRANGE;
+    if (a.type == b.type && kernel != NULL){
+        res.status = kernel(c, a.value, b.value, &res.out.value);
     }
 
-    TypeResult res = {.status = status, .out = t};
+#ifdef TYPE_TIMESTAMP
+    res.out.timestamp = type_stamp();
+#endif
+    return res;
+}/* value_sat */
+
+TypeResult type_sum_sat(const TypeValue a, const TypeValue b)
+{
+    PROFILE(TYPE_PROF_SUM_SAT, a.type);
+
+    TypeResult res = value_sat(a, b, store_sum_sat, store_sum_sat);
+
+    STATS_COUNT(TYPE_OP_SUM_SAT, a.type, res.status);
+    return res;
+}/* type_sum_sat */
+
+TypeResult type_mul_sat(const TypeValue a, const TypeValue b)
+{
+    PROFILE(TYPE_PROF_MUL_SAT, a.type);
+
+    TypeResult res = value_sat(a, b, store_imul_sat, store_dmul_sat);
+
+    STATS_COUNT(TYPE_OP_MUL_SAT, a.type, res.status);
+    return res;
+}/* type_mul_sat */
+
+static
+TypeResult decimal_div(const struct TypeDesc *c,
+                       const TypeValue a, const TypeValue b)
+{
+    TypeValue t = {.type = a.type, .value = 0};
+    TypeResult res = {.status = TS_OK, .out = t};
+
+    res.status = store_ddiv(c, a.value, b.value, &res.out.value);
 
     return res;
 } /* decimal_div */
 
 
+/* Integer division with the divisor and the range checks: the quotient
+ * can leave the range, e.g. -128 / -1 on [-128, 127] or 100 / 50 on
+ * [5, 100]. LLONG_MIN / -1 would overflow.
+ */
+static inline
+enum TypeStatus store_idiv(const struct TypeDesc *c, type_value_store va,
+                           type_value_store vb, type_value_store *out)
+{
+    if (vb == 0 || (vb == -1 && va == LLONG_MIN)){
+        *out = 0;
+        return TS_OUTRANGE;
+    }
+
+    *out = va / vb;
+    return store_in_range(c, *out) ? TS_OK : TS_OUTRANGE;
+}/* store_idiv */
+
 TypeResult type_div(const TypeValue a, const TypeValue b)
 {
-    assert(validate_value(a));
-    assert(validate_value(b));
+    PROFILE(TYPE_PROF_DIV, a.type);
+
+    const struct TypeTable *tt = type_table();
+
+    assert(validate_value(tt, a));
+    assert(validate_value(tt, b));
 
     TypeValue t = {.type = a.type, .value = 0};
     TypeResult res = {.status = TS_INCOMPATIBLE, .out = t};
 
     if (a.type != b.type){
+        STATS_COUNT(TYPE_OP_DIV, a.type, res.status);
         return res;
     }
 
     /* avoid division by zero */
-    if (config[a.type].category != NOMINAL && b.value == 0) {
+    if (tt->desc[a.type].category != NOMINAL && b.value == 0) {
         res.status = TS_OUTRANGE;
+        STATS_COUNT(TYPE_OP_DIV, a.type, res.status);
         return res;
     }
 
-    switch (config[a.type].category){
+    switch (tt->desc[a.type].category){
     case NOMINAL:
         res.status = TS_INCOMPATIBLE;
         break;
     case INTEGER:
-        t.value = a.value / b.value;
-        res.status = TS_OK;
-        res.out = t;
+        res.status = store_idiv(&tt->desc[a.type], a.value, b.value,
+                                &res.out.value);
         break;
     case DECIMAL:
-        res = decimal_div(a, b);
+        res = decimal_div(&tt->desc[a.type], a, b);
         break;
     default:
         errx(EXIT_FAILURE, "Invalid category configuration for type: %i", a.type);
@@ -432,59 +1640,3635 @@ TypeResult type_div(const TypeValue a, const TypeValue b)
     }/* switch */
 
 #ifdef TYPE_TIMESTAMP
-    res.out.timestamp = type_now();
+    res.out.timestamp = type_stamp();
 #endif
+    STATS_COUNT(TYPE_OP_DIV, a.type, res.status);
     return res;
 } /* type_div */
 
-int type_dec_units(const TypeValue tv)
+static inline
+enum TypeStatus store_ddiv_checked(const struct TypeDesc *c,
+                                   type_value_store va, type_value_store vb,
+                                   type_value_store *out)
 {
-    assert(config[tv.type].category == DECIMAL);
-    return tv.value / TYPE_DECIMAL_POWER;
-}/* type_dec_unites */
+    if (vb == 0){
+        *out = 0;
+        return TS_OUTRANGE;
+    }
 
-int type_dec_decimals(const TypeValue tv)
+    return store_ddiv(c, va, vb, out);
+}/* store_ddiv_checked */
+
+/* Apply the kernel to every pair of the same type of a[0].
+ * Being inline with a constant kernel, the call is resolved at compile time
+ * and the loop has no dispatch at all.
+ */
+static inline
+int batch_apply(const struct TypeTable *tt,
+                TypeValue *out, enum TypeStatus *status,
+                const TypeValue *a, const TypeValue *b, int n,
+                store_kernel kernel, enum TypeStatOp op)
 {
-    assert(config[tv.type].category == DECIMAL);
-    int precision = config[tv.type].precision;
-    type_value_store power = exp10((double)(TYPE_DECIMAL_DIGITS - precision));
-    return (tv.value % TYPE_DECIMAL_POWER) / power;
-}/* type_dec_decimals */
+    const int type = a[0].type;
+    const struct TypeDesc *c = &tt->desc[type];
+    int outrange = 0;
+    int incompatible = 0;
+#ifdef TYPE_TIMESTAMP
+    const type_millisecs now = type_stamp();
+#endif
+
+    for (int i=0; i < n; i++){
+        assert(validate_value(tt, a[i]));
+        assert(validate_value(tt, b[i]));
+
+        type_value_store v = 0;
+        enum TypeStatus st = TS_INCOMPATIBLE;
 
-/* Convert DECIMAL to string */
+        if (a[i].type == type && b[i].type == type){
+            st = kernel(c, a[i].value, b[i].value, &v);
+        }
+
+        /* out can alias a or b, the inputs are already read */
+        out[i].type = a[i].type;
+        out[i].value = v;
+#ifdef TYPE_TIMESTAMP
+        out[i].timestamp = now;
+#endif
+        if (status != NULL){
+            status[i] = st;
+        }
+        outrange += (st == TS_OUTRANGE);
+        incompatible += (st == TS_INCOMPATIBLE);
+    }
+
+    STATS_COUNT_N(op, type, n, outrange, incompatible);
+    return outrange + incompatible;
+}/* batch_apply */
+
+/* set all the results as failed, the values are zero */
 static
-void str_decimals(char *buf, const TypeValue tv)
+int batch_fail(TypeValue *out, enum TypeStatus *status,
+               const TypeValue *a, int n, enum TypeStatus st,
+               enum TypeStatOp op)
+{
+#ifdef TYPE_TIMESTAMP
+    const type_millisecs now = type_stamp();
+#endif
+
+    for (int i=0; i < n; i++){
+        out[i].type = a[i].type;
+        out[i].value = 0;
+#ifdef TYPE_TIMESTAMP
+        out[i].timestamp = now;
+#endif
+        if (status != NULL){
+            status[i] = st;
+        }
+    }
+
+    STATS_COUNT_N(op, (n > 0) ? a[0].type : -1, n,
+                  (st == TS_OUTRANGE) ? n : 0, (st == TS_INCOMPATIBLE) ? n : 0);
+    return n;
+}/* batch_fail */
+
+int type_sum_n(TypeValue *out, enum TypeStatus *status,
+               const TypeValue *a, const TypeValue *b, int n)
 {
-    /* format string with decimal precision */
-    char fmt[10] = {'\0'};
-    sprintf(fmt, "%%i.%%0%ii", config[tv.type].precision);
+    PROFILE(TYPE_PROF_SUM_N, (n > 0) ? a[0].type : -1);
 
-    snprintf(buf, TYPE_STR_LEN-1, fmt,
-                type_dec_units(tv),
-                type_dec_decimals(tv));
-}/* str_decimals */
+    const struct TypeTable *tt = type_table();
 
-void type_str(char *buf, const TypeValue tv)
+    assert(n >= 0);
+    if (n <= 0){
+        return 0;
+    }
+
+    assert(validate_type(tt, a[0].type));
+
+    switch (tt->desc[a[0].type].category){
+    case NOMINAL:
+        return batch_fail(out, status, a, n, TS_INCOMPATIBLE,
+                          TYPE_OP_SUM);
+    case INTEGER: /* fall through */
+    case DECIMAL:
+        return batch_apply(tt, out, status, a, b, n, store_sum,
+                           TYPE_OP_SUM);
+    default:
+        errx(EXIT_FAILURE, "Invalid category configuration for type: %i", a[0].type);
+        break;
+    }/* switch */
+
+    return n;
+}/* type_sum_n */
+
+int type_mul_n(TypeValue *out, enum TypeStatus *status,
+               const TypeValue *a, const TypeValue *b, int n)
 {
-    memset(buf, 0, TYPE_STR_LEN);
+    PROFILE(TYPE_PROF_MUL_N, (n > 0) ? a[0].type : -1);
 
-    switch (config[tv.type].category){
-    case NOMINAL: /* fall through */
+    const struct TypeTable *tt = type_table();
+
+    assert(n >= 0);
+    if (n <= 0){
+        return 0;
+    }
+
+    assert(validate_type(tt, a[0].type));
+
+    switch (tt->desc[a[0].type].category){
+    case NOMINAL:
+        return batch_fail(out, status, a, n, TS_INCOMPATIBLE,
+                          TYPE_OP_MUL);
     case INTEGER:
-        snprintf(buf, TYPE_STR_LEN-1, "%lli", tv.value);
+        return batch_apply(tt, out, status, a, b, n, store_imul,
+                           TYPE_OP_MUL);
+    case DECIMAL:
+        return batch_apply(tt, out, status, a, b, n, store_dmul,
+                           TYPE_OP_MUL);
+    default:
+        errx(EXIT_FAILURE, "Invalid category configuration for type: %i", a[0].type);
         break;
+    }/* switch */
+
+    return n;
+}/* type_mul_n */
+
+int type_div_n(TypeValue *out, enum TypeStatus *status,
+               const TypeValue *a, const TypeValue *b, int n)
+{
+    PROFILE(TYPE_PROF_DIV_N, (n > 0) ? a[0].type : -1);
+
+    const struct TypeTable *tt = type_table();
+
+    assert(n >= 0);
+    if (n <= 0){
+        return 0;
+    }
+
+    assert(validate_type(tt, a[0].type));
+
+    switch (tt->desc[a[0].type].category){
+    case NOMINAL:
+        return batch_fail(out, status, a, n, TS_INCOMPATIBLE,
+                          TYPE_OP_DIV);
+    case INTEGER:
+        return batch_apply(tt, out, status, a, b, n, store_idiv,
+                           TYPE_OP_DIV);
     case DECIMAL:
-        str_decimals(buf, tv);
+        return batch_apply(tt, out, status, a, b, n, store_ddiv_checked,
+                           TYPE_OP_DIV);
+    default:
+        errx(EXIT_FAILURE, "Invalid category configuration for type: %i", a[0].type);
         break;
+    }/* switch */
+
+    return n;
+}/* type_div_n */
+
+int type_sum_sat_n(TypeValue *out, enum TypeStatus *status,
+                   const TypeValue *a, const TypeValue *b, int n)
+{
+    PROFILE(TYPE_PROF_SUM_SAT_N, (n > 0) ? a[0].type : -1);
+
+    const struct TypeTable *tt = type_table();
+
+    assert(n >= 0);
+    if (n <= 0){
+        return 0;
+    }
+
+    assert(validate_type(tt, a[0].type));
+
+    switch (tt->desc[a[0].type].category){
+    case NOMINAL:
+        return batch_fail(out, status, a, n, TS_INCOMPATIBLE,
+                          TYPE_OP_SUM_SAT);
+    case INTEGER: /* fall through */
+    case DECIMAL:
+        return batch_apply(tt, out, status, a, b, n, store_sum_sat,
+                           TYPE_OP_SUM_SAT);
     default:
-        errx(EXIT_FAILURE, "Invalid category configuration for type: %i", tv.type);
+        errx(EXIT_FAILURE, "Invalid category configuration for type: %i", a[0].type);
         break;
     }/* switch */
-}/* type_str */
 
-#ifdef TYPE_TIMESTAMP
-type_millisecs type_get_time(const TypeValue tv)
+    return n;
+}/* type_sum_sat_n */
+
+int type_mul_sat_n(TypeValue *out, enum TypeStatus *status,
+                   const TypeValue *a, const TypeValue *b, int n)
 {
-    return tv.timestamp;
-}/* type_get_time */
+    PROFILE(TYPE_PROF_MUL_SAT_N, (n > 0) ? a[0].type : -1);
+
+    const struct TypeTable *tt = type_table();
+
+    assert(n >= 0);
+    if (n <= 0){
+        return 0;
+    }
+
+    assert(validate_type(tt, a[0].type));
+
+    switch (tt->desc[a[0].type].category){
+    case NOMINAL:
+        return batch_fail(out, status, a, n, TS_INCOMPATIBLE,
+                          TYPE_OP_MUL_SAT);
+    case INTEGER:
+        return batch_apply(tt, out, status, a, b, n, store_imul_sat,
+                           TYPE_OP_MUL_SAT);
+    case DECIMAL:
+        return batch_apply(tt, out, status, a, b, n, store_dmul_sat,
+                           TYPE_OP_MUL_SAT);
+    default:
+        errx(EXIT_FAILURE, "Invalid category configuration for type: %i", a[0].type);
+        break;
+    }/* switch */
+
+    return n;
+}/* type_mul_sat_n */
+
+/* Fused operations.
+ * The intermediate results are exact (with TYPE_WIDE) and not checked:
+ * only the final result is cut to the precision and checked on the range.
+ */
+
+/* va * vb + vc, the store_kernel of the fused operations */
+typedef enum TypeStatus (*fused_kernel)(const struct TypeDesc *c,
+                                        type_value_store va,
+                                        type_value_store vb,
+                                        type_value_store vc,
+                                        type_value_store *out);
+
+static inline
+enum TypeStatus store_ifma(const struct TypeDesc *c, type_value_store va,
+                           type_value_store vb, type_value_store vc,
+                           type_value_store *out)
+{
+    bool overflow = false;
+
+#ifdef TYPE_WIDE
+    type_wide wide = (type_wide)va * vb + vc;
+    *out = (type_value_store)wide;
+    overflow = ((type_wide)*out != wide);
+#else
+    type_value_store mul = 0;
+    overflow = __builtin_mul_overflow(va, vb, &mul) ||
+               __builtin_add_overflow(mul, vc, out);
+#endif
+
+    return (overflow || !store_in_range(c, *out)) ? TS_OUTRANGE : TS_OK;
+}/* store_ifma */
+
+/* one truncation of the exact value, two without TYPE_WIDE */
+static inline
+enum TypeStatus store_dfma(const struct TypeDesc *c, type_value_store va,
+                           type_value_store vb, type_value_store vc,
+                           type_value_store *out)
+{
+    type_value_store mul = 0;
+    type_value_store add = 0;
+    type_value_store v = 0;
+    bool overflow = false;
+
+    //v = (va * vb + vc * POWER) / POWER;
+    if (!__builtin_mul_overflow(va, vb, &mul) &&
+        !__builtin_mul_overflow(vc, (type_value_store)TYPE_DECIMAL_POWER, &add) &&
+        !__builtin_add_overflow(mul, add, &v)){
+        /* common case, division by a constant */
+        v = v / TYPE_DECIMAL_POWER;
+    } else {
+#ifdef TYPE_WIDE
+        /* |va * vb| < 2^126, |vc * POWER| < 2^84: no overflow */
+        type_wide wide = ((type_wide)va * vb +
+                          (type_wide)vc * TYPE_DECIMAL_POWER) / TYPE_DECIMAL_POWER;
+        v = (type_value_store)wide;
+        overflow = ((type_wide)v != wide);
+#else
+        overflow = dmul_raw(va, vb, &mul) || __builtin_add_overflow(mul, vc, &v);
+#endif
+    }
+
+    *out = desc_cut(c, v); /* enforce precision */
+    return (overflow || !store_in_range(c, *out)) ? TS_OUTRANGE : TS_OK;
+}/* store_dfma */
+
+/* the kernel for the category, NULL if the category has no arithmetic */
+static
+fused_kernel fused_select(const TypeValue a, const struct TypeDesc *c)
+{
+    switch (c->category){
+    case NOMINAL:
+        return NULL;
+    case INTEGER:
+        return store_ifma;
+    case DECIMAL:
+        return store_dfma;
+    default:
+        errx(EXIT_FAILURE, "Invalid category configuration for type: %i", a.type);
+        break;
+    }/* switch */
+
+    return NULL;
+}/* fused_select */
+
+TypeResult type_fma(const TypeValue a, const TypeValue b, const TypeValue c)
+{
+    PROFILE(TYPE_PROF_FMA, a.type);
+
+    const struct TypeTable *tt = type_table();
+
+    assert(validate_value(tt, a));
+    assert(validate_value(tt, b));
+    assert(validate_value(tt, c));
+
+    TypeValue t = {.type = a.type, .value = 0};
+    TypeResult res = {.status = TS_INCOMPATIBLE, .out = t};
+    const struct TypeDesc *d = &tt->desc[a.type];
+    fused_kernel kernel = fused_select(a, d);
+
+    if (a.type == b.type && a.type == c.type && kernel != NULL){
+        res.status = kernel(d, a.value, b.value, c.value, &res.out.value);
+    }
+
+#ifdef TYPE_TIMESTAMP
+    res.out.timestamp = type_stamp();
+#endif
+    STATS_COUNT(TYPE_OP_FUSED, a.type, res.status);
+    return res;
+}/* type_fma */
+
+/* va + (vb - va) * t / POWER, between va and vb so it always fits */
+static inline
+enum TypeStatus store_lerp(const struct TypeDesc *c, type_value_store va,
+                           type_value_store vb, type_decimal t,
+                           type_value_store *out)
+{
+    type_value_store v = 0;
+
+#ifdef TYPE_WIDE
+    v = (type_value_store)(va + (((type_wide)vb - va) * t) / TYPE_DECIMAL_POWER);
+#else
+    /* va * (1 - t) + vb * t: the terms are not larger than the values and
+     * with different signs when large, so nothing overflows
+     */
+    type_value_store x = 0;
+    type_value_store y = 0;
+
+    dmul_raw(va, TYPE_DECIMAL_POWER - t, &x);
+    dmul_raw(vb, t, &y);
+    v = x + y;
+#endif
+
+    *out = desc_cut(c, v); /* enforce precision */
+    return store_in_range(c, *out) ? TS_OK : TS_OUTRANGE;
+}/* store_lerp */
+
+TypeResult type_lerp(const TypeValue a, const TypeValue b, type_decimal t)
+{
+    PROFILE(TYPE_PROF_LERP, a.type);
+
+    const struct TypeTable *tt = type_table();
+
+    assert(validate_value(tt, a));
+    assert(validate_value(tt, b));
+    assert(t >= 0 && t <= TYPE_DECIMAL_POWER);
+
+    TypeValue v = {.type = a.type, .value = 0};
+    TypeResult res = {.status = TS_INCOMPATIBLE, .out = v};
+    const struct TypeDesc *d = &tt->desc[a.type];
+
+    if (a.type == b.type && d->category != NOMINAL){
+        res.status = store_lerp(d, a.value, b.value, t, &res.out.value);
+    }
+
+#ifdef TYPE_TIMESTAMP
+    res.out.timestamp = type_stamp();
+#endif
+    STATS_COUNT(TYPE_OP_FUSED, a.type, res.status);
+    return res;
+}/* type_lerp */
+
+TypeResult type_clamp_add(const TypeValue a, const TypeValue b,
+                          const TypeValue lo, const TypeValue hi)
+{
+    PROFILE(TYPE_PROF_CLAMP_ADD, a.type);
+
+    const struct TypeTable *tt = type_table();
+
+    assert(validate_value(tt, a));
+    assert(validate_value(tt, b));
+    assert(validate_value(tt, lo));
+    assert(validate_value(tt, hi));
+    assert(lo.value <= hi.value);
+
+    TypeValue t = {.type = a.type, .value = 0};
+    TypeResult res = {.status = TS_INCOMPATIBLE, .out = t};
+
+    if (a.type == b.type && a.type == lo.type && a.type == hi.type &&
+        tt->desc[a.type].category != NOMINAL){
+        type_value_store sum = 0;
+        bool overflow = __builtin_add_overflow(a.value, b.value, &sum);
+
+        /* on overflow the sign of b tells the side */
+        sum = overflow ? ((b.value < 0) ? LLONG_MIN : LLONG_MAX) : sum;
+
+        bool clamped = overflow || (sum < lo.value) || (sum > hi.value);
+        sum = (sum < lo.value) ? lo.value : sum;
+        sum = (sum > hi.value) ? hi.value : sum;
+
+        res.out.value = sum;
+        res.status = clamped ? TS_OUTRANGE : TS_OK;
+    }
+
+#ifdef TYPE_TIMESTAMP
+    res.out.timestamp = type_stamp();
+#endif
+    STATS_COUNT(TYPE_OP_FUSED, a.type, res.status);
+    return res;
+}/* type_clamp_add */
+
+int type_fma_n(TypeValue *out, enum TypeStatus *status, const TypeValue *x,
+               const TypeValue gain, const TypeValue offset, int n)
+{
+    PROFILE(TYPE_PROF_FMA_N, gain.type);
+
+    const struct TypeTable *tt = type_table();
+
+    assert(n >= 0);
+    assert(n == 0 || (out != NULL && status != NULL && x != NULL));
+    assert(validate_value(tt, gain));
+    assert(validate_value(tt, offset));
+
+    const int type = gain.type;
+    const struct TypeDesc *d = &tt->desc[type];
+    fused_kernel kernel = fused_select(gain, d);
+
+    if (kernel == NULL || offset.type != type){
+        return batch_fail(out, status, x, n, TS_INCOMPATIBLE, TYPE_OP_FUSED);
+    }
+
+    int outrange = 0;
+    int incompatible = 0;
+#ifdef TYPE_TIMESTAMP
+    const type_millisecs now = type_stamp();
+#endif
+
+    for (int i=0; i < n; i++){
+        assert(validate_value(tt, x[i]));
+
+        type_value_store v = 0;
+        enum TypeStatus st = TS_INCOMPATIBLE;
+
+        if (x[i].type == type){
+            st = kernel(d, x[i].value, gain.value, offset.value, &v);
+        }
+
+        /* out can alias x, the input is already read */
+        out[i].type = x[i].type;
+        out[i].value = v;
+#ifdef TYPE_TIMESTAMP
+        out[i].timestamp = now;
+#endif
+        status[i] = st;
+        outrange += (st == TS_OUTRANGE);
+        incompatible += (st == TS_INCOMPATIBLE);
+    }
+
+    STATS_COUNT_N(TYPE_OP_FUSED, (n > 0) ? x[0].type : -1, n, outrange,
+                  incompatible);
+    return outrange + incompatible;
+}/* type_fma_n */
+
+/* Conversions */
+
+/* the internal store of a value of the type is value * power */
+static
+type_value_store scale_power(const struct TypeDesc *c)
+{
+    return (c->category == DECIMAL) ? TYPE_DECIMAL_POWER : 1;
+}/* scale_power */
+
+static
+type_value_store scale_gcd(type_value_store a, type_value_store b)
+{
+    while (b != 0){
+        type_value_store r = a % b;
+        a = b;
+        b = r;
+    }
+    return a;
+}/* scale_gcd */
+
+/* mul/div *= fm/fd, reduced, return true on overflow */
+static
+bool scale_factor(type_value_store *mul, type_value_store *div,
+                  type_value_store fm, type_value_store fd)
+{
+    if (__builtin_mul_overflow(*mul, fm, mul) ||
+        __builtin_mul_overflow(*div, fd, div)){
+        return true;
+    }
+
+    type_value_store g = scale_gcd(*mul, *div);
+    *mul /= g;
+    *div /= g;
+    return false;
+}/* scale_factor */
+
+/* a / b rounded toward -inf and +inf, b > 0 */
+static
+type_value_store floor_div(type_value_store a, type_value_store b)
+{
+    return a / b - ((a % b != 0) & (a < 0));
+}/* floor_div */
+
+static
+type_value_store ceil_div(type_value_store a, type_value_store b)
+{
+    return a / b + ((a % b != 0) & (a > 0));
+}/* ceil_div */
+
+/* Quotient of the scale, exact for every v with 128 bits integers,
+ * only for |v| <= LLONG_MAX / mul without.
+ */
+#ifdef TYPE_WIDE
+typedef type_wide scale_quot_t;
+#else
+typedef type_value_store scale_quot_t;
+#endif
+
+static inline
+scale_quot_t scale_quot(const struct TypeScale *s, type_value_store v)
+{
+    return (scale_quot_t)v * s->mul / s->div;
+}/* scale_quot */
+
+/* The first v in [lo, hi] with trunc(v * mul / div) >= q.
+ * The quotient grows with v and the one of hi must be >= q.
+ */
+static
+type_value_store scale_first(const struct TypeScale *s, type_value_store lo,
+                             type_value_store hi, scale_quot_t q)
+{
+    while (lo < hi){
+        /* hi - lo can exceed the signed range */
+        type_value_store mid = lo + (type_value_store)
+            (((unsigned long long)hi - (unsigned long long)lo) / 2);
+
+        if (scale_quot(s, mid) >= q){
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return lo;
+}/* scale_first */
+
+struct TypeScale type_scale(int from, int to, long long num, long long den)
+{
+    const struct TypeTable *tt = type_table();
+
+    assert(validate_type(tt, from));
+    assert(validate_type(tt, to));
+    assert(num > 0 && den > 0);
+
+    const struct TypeDesc *cf = &tt->desc[from];
+    const struct TypeDesc *ct = &tt->desc[to];
+    struct TypeScale s = {.from = from, .to = to, .mul = 1, .div = 1,
+                          .cut = ct->cut};
+
+    /* out = trunc(v * num * Pto / (den * Pfrom)) truncated to the precision,
+     * two truncations toward zero are one with the product of the divisors
+     */
+    if (scale_factor(&s.mul, &s.div, num, den) ||
+        scale_factor(&s.mul, &s.div, scale_power(ct), scale_power(cf)) ||
+        scale_factor(&s.mul, &s.div, 1, ct->cut)){
+        errx(EXIT_FAILURE, "Conversion scale out of range: %lld/%lld",
+             num, den);
+    }
+    s.divInv = ~0ULL / (unsigned long long)s.div;
+
+    /* v * mul does not overflow in [-lim, lim] */
+    const type_value_store lim = LLONG_MAX / s.mul;
+#ifdef TYPE_WIDE
+    const type_value_store lo = LLONG_MIN;
+    const type_value_store hi = LLONG_MAX;
+#else
+    const type_value_store lo = -lim;
+    const type_value_store hi = lim;
+#endif
+    const type_value_store qlo = ceil_div(ct->rangeMin, ct->cut);
+    const type_value_store qhi = floor_div(ct->rangeMax, ct->cut);
+
+    /* the inputs with a result in range */
+    if (scale_quot(&s, hi) < qlo || scale_quot(&s, lo) > qhi){
+        s.inMin = 1; /* empty */
+        s.inMax = 0;
+    } else {
+        s.inMin = scale_first(&s, lo, hi, qlo);
+        s.inMax = (scale_quot(&s, hi) <= qhi) ?
+                  hi : scale_first(&s, lo, hi, (scale_quot_t)qhi + 1) - 1;
+    }
+
+    s.fastMin = (s.inMin > -lim) ? s.inMin : -lim;
+    s.fastMax = (s.inMax < lim) ? s.inMax : lim;
+
+    return s;
+}/* type_scale */
+
+/* both the types have a value to scale */
+static
+bool scale_valid(const struct TypeTable *tt, const struct TypeScale *s)
+{
+    return (tt->desc[s->from].category != NOMINAL) &&
+           (tt->desc[s->to].category != NOMINAL);
+}/* scale_valid */
+
+static inline
+enum TypeStatus store_scale(const struct TypeScale *s, type_value_store v,
+                            type_value_store *out)
+{
+    bool bad = (v < s->inMin) | (v > s->inMax);
+
+#ifdef TYPE_WIDE
+    if (__builtin_expect(!bad && (v < s->fastMin || v > s->fastMax), 0)){
+        *out = (type_value_store)scale_quot(s, v) * s->cut;
+        return TS_OK;
+    }
+#endif
+    type_value_store p = (bad ? 0 : v) * s->mul;
+
+    *out = recip_div(p, s->div, s->divInv) * s->cut;
+    return bad ? TS_OUTRANGE : TS_OK;
+}/* store_scale */
+
+TypeResult type_convert(const struct TypeScale *s, const TypeValue tv)
+{
+    PROFILE(TYPE_PROF_CONVERT, tv.type);
+
+    const struct TypeTable *tt = type_table();
+
+    assert(s != NULL);
+    assert(validate_type(tt, s->from) && validate_type(tt, s->to));
+    assert(validate_value(tt, tv));
+
+    TypeValue t = {.type = s->to, .value = 0};
+    TypeResult res = {.status = TS_INCOMPATIBLE, .out = t};
+
+    if (tv.type == s->from && scale_valid(tt, s)){
+        res.status = store_scale(s, tv.value, &res.out.value);
+    }
+
+#ifdef TYPE_TIMESTAMP
+    res.out.timestamp = type_stamp();
+#endif
+    STATS_COUNT(TYPE_OP_CONVERT, tv.type, res.status);
+    return res;
+}/* type_convert */
+
+int type_convert_n(TypeValue *out, enum TypeStatus *status,
+                   const struct TypeScale *s, const TypeValue *in, int n)
+{
+    PROFILE(TYPE_PROF_CONVERT_N, s->from);
+
+    const struct TypeTable *tt = type_table();
+
+    assert(s != NULL);
+    assert(n >= 0);
+    assert(n == 0 || (out != NULL && status != NULL && in != NULL));
+    assert(validate_type(tt, s->from) && validate_type(tt, s->to));
+
+    const bool valid = scale_valid(tt, s);
+    int outrange = 0;
+    int incompatible = 0;
+#ifdef TYPE_TIMESTAMP
+    const type_millisecs now = type_stamp();
+#endif
+
+    for (int i=0; i < n; i++){
+        assert(validate_value(tt, in[i]));
+
+        type_value_store v = 0;
+        enum TypeStatus st = TS_INCOMPATIBLE;
+
+        if (valid && in[i].type == s->from){
+            st = store_scale(s, in[i].value, &v);
+        }
+
+        /* out can alias in, the input is already read */
+        out[i].type = s->to;
+        out[i].value = v;
+#ifdef TYPE_TIMESTAMP
+        out[i].timestamp = now;
+#endif
+        status[i] = st;
+        outrange += (st == TS_OUTRANGE);
+        incompatible += (st == TS_INCOMPATIBLE);
+    }
+
+    STATS_COUNT_N(TYPE_OP_CONVERT, (n > 0) ? in[0].type : -1, n, outrange,
+                  incompatible);
+    return outrange + incompatible;
+}/* type_convert_n */
+
+static inline
+type_packed pack_encode(int type, type_value_store v)
+{
+    return ((type_packed)v << TYPE_PACK_TYPE_BITS) | (type_packed)type;
+}/* pack_encode */
+
+static inline
+int pack_type(type_packed p)
+{
+    return (int)(p & PACK_TYPE_MASK);
+}/* pack_type */
+
+/* arithmetic shift, the sign is kept */
+static inline
+type_value_store pack_value(type_packed p)
+{
+    return (type_value_store)p >> TYPE_PACK_TYPE_BITS;
+}/* pack_value */
+
+int type_packable(int type)
+{
+    const struct TypeTable *tt = type_table();
+
+    assert(validate_type(tt, type));
+    return tt->desc[type].packable;
+}/* type_packable */
+
+enum TypeStatus type_pack(type_packed *out, const TypeValue tv)
+{
+    PROFILE(TYPE_PROF_PACK, tv.type);
+
+    const struct TypeTable *tt = type_table();
+
+    assert(out != NULL);
+    assert(validate_value(tt, tv));
+
+    if (!tt->desc[tv.type].packable){
+        return TS_INCOMPATIBLE;
+    }
+
+    *out = pack_encode(tv.type, tv.value);
+    return TS_OK;
+}/* type_pack */
+
+TypeValue type_unpack(type_packed p)
+{
+    PROFILE(TYPE_PROF_UNPACK, pack_type(p));
+
+    assert(validate_packed(type_table(), p));
+
+    TypeValue t = {.type = pack_type(p), .value = pack_value(p)};
+#ifdef TYPE_TIMESTAMP
+    t.timestamp = 0;
+#endif
+    return t;
+}/* type_unpack */
+
+int type_pack_n(type_packed *out, enum TypeStatus *status,
+                const TypeValue *tv, int n)
+{
+    PROFILE(TYPE_PROF_PACK_N, (n > 0) ? tv[0].type : -1);
+
+    const struct TypeTable *tt = type_table();
+    int failed = 0;
+
+    assert(n >= 0);
+    assert(n == 0 || (out != NULL && status != NULL && tv != NULL));
+
+    for (int i=0; i < n; i++){
+        assert(validate_value(tt, tv[i]));
+
+        bool ok = tt->desc[tv[i].type].packable;
+
+        out[i] = ok ? pack_encode(tv[i].type, tv[i].value) : 0;
+        status[i] = ok ? TS_OK : TS_INCOMPATIBLE;
+        failed += !ok;
+    }
+
+    return failed;
+}/* type_pack_n */
+
+void type_unpack_n(TypeValue *out, const type_packed *p, int n)
+{
+    PROFILE(TYPE_PROF_UNPACK_N, (n > 0) ? pack_type(p[0]) : -1);
+
+    assert(n >= 0);
+    assert(n == 0 || (out != NULL && p != NULL));
+
+    for (int i=0; i < n; i++){
+        out[i] = type_unpack(p[i]);
+    }
+}/* type_unpack_n */
+
+/* Apply the kernel to packed values of the type of a.
+ * The kernels check the range, that fits the packed value.
+ */
+static inline
+struct TypePackedResult pack_apply(const struct TypeTable *tt,
+                                   type_packed a, type_packed b,
+                                   store_kernel kernel)
+{
+    const int type = pack_type(a);
+    struct TypePackedResult res = {.status = TS_INCOMPATIBLE,
+                                   .out = pack_encode(type, 0)};
+
+    if (pack_type(b) != type){
+        return res;
+    }
+
+    type_value_store v = 0;
+    res.status = kernel(&tt->desc[type], pack_value(a), pack_value(b), &v);
+
+    if (res.status == TS_OK){
+        res.out = pack_encode(type, v);
+    }
+
+    return res;
+}/* pack_apply */
+
+struct TypePackedResult type_pack_sum(type_packed a, type_packed b)
+{
+    PROFILE(TYPE_PROF_PACK_SUM, pack_type(a));
+
+    const struct TypeTable *tt = type_table();
+
+    assert(validate_packed(tt, a));
+    assert(validate_packed(tt, b));
+
+    struct TypePackedResult res = {.status = TS_INCOMPATIBLE,
+                                   .out = pack_encode(pack_type(a), 0)};
+
+    switch (tt->desc[pack_type(a)].category){
+    case NOMINAL:
+        break;
+    case INTEGER: /* fall through */
+    case DECIMAL:
+        res = pack_apply(tt, a, b, store_sum);
+        break;
+    default:
+        errx(EXIT_FAILURE, "Invalid category configuration for type: %i",
+             pack_type(a));
+        break;
+    }/* switch */
+
+    return res;
+}/* type_pack_sum */
+
+struct TypePackedResult type_pack_mul(type_packed a, type_packed b)
+{
+    PROFILE(TYPE_PROF_PACK_MUL, pack_type(a));
+
+    const struct TypeTable *tt = type_table();
+
+    assert(validate_packed(tt, a));
+    assert(validate_packed(tt, b));
+
+    struct TypePackedResult res = {.status = TS_INCOMPATIBLE,
+                                   .out = pack_encode(pack_type(a), 0)};
+
+    switch (tt->desc[pack_type(a)].category){
+    case NOMINAL:
+        break;
+    case INTEGER:
+        res = pack_apply(tt, a, b, store_imul);
+        break;
+    case DECIMAL:
+        res = pack_apply(tt, a, b, store_dmul);
+        break;
+    default:
+        errx(EXIT_FAILURE, "Invalid category configuration for type: %i",
+             pack_type(a));
+        break;
+    }/* switch */
+
+    return res;
+}/* type_pack_mul */
+
+struct TypePackedResult type_pack_div(type_packed a, type_packed b)
+{
+    PROFILE(TYPE_PROF_PACK_DIV, pack_type(a));
+
+    const struct TypeTable *tt = type_table();
+
+    assert(validate_packed(tt, a));
+    assert(validate_packed(tt, b));
+
+    struct TypePackedResult res = {.status = TS_INCOMPATIBLE,
+                                   .out = pack_encode(pack_type(a), 0)};
+
+    switch (tt->desc[pack_type(a)].category){
+    case NOMINAL:
+        break;
+    case INTEGER:
+        res = pack_apply(tt, a, b, store_idiv);
+        break;
+    case DECIMAL:
+        res = pack_apply(tt, a, b, store_ddiv_checked);
+        break;
+    default:
+        errx(EXIT_FAILURE, "Invalid category configuration for type: %i",
+             pack_type(a));
+        break;
+    }/* switch */
+
+    return res;
+}/* type_pack_div */
+
+/* Vector kernels on the raw stores.
+ * Every kernel has a scalar version, that is the reference, and the x86
+ * versions selected at run time on the CPU features.
+ * The vector versions give exactly the same values and statuses.
+ *
+ * range:   count (and mark) the values out of [min, max].
+ * sum:     checked sum as store_sum, only the TS_OK results are stored.
+ * sum_sat: sum clamped to [min, max], always stored, the status marks the
+ *          saturated elements with TS_OUTRANGE (can be NULL).
+ * clamp:   clamp the values to [min, max] in place, same status as sum_sat.
+ * reduce:  accumulate the values in the partial result of a reduction.
+ * convert: conversion as store_scale, only the TS_OK results are stored.
+ */
+
+/* Partial result of a reduction.
+ * Every value is split as v = hi * 2^32 + lo with lo in [0, 2^32), and the
+ * halves are summed apart: less than 2^31 halves cannot overflow, so the
+ * total is exact and it is checked only at the end.
+ */
+struct ReducePart {
+    type_value_store hi;
+    type_value_store lo;
+    type_value_store min;
+    type_value_store max;
+};
+
+struct SimdKernels {
+    enum TypeSimd level;
+    int (*range)(const type_value_store *v, int n,
+                 type_value_store min, type_value_store max,
+                 enum TypeStatus *status);
+    int (*sum)(type_value_store *out, enum TypeStatus *status,
+               const type_value_store *a, const type_value_store *b, int n,
+               type_value_store min, type_value_store max);
+    int (*sum_sat)(type_value_store *out, enum TypeStatus *status,
+                   const type_value_store *a, const type_value_store *b, int n,
+                   type_value_store min, type_value_store max);
+    int (*clamp)(type_value_store *v, enum TypeStatus *status, int n,
+                 type_value_store min, type_value_store max);
+    void (*reduce)(const type_value_store *v, int n, struct ReducePart *p);
+    int (*convert)(type_value_store *out, enum TypeStatus *status,
+                   const type_value_store *v, int n,
+                   const struct TypeScale *s);
+};
+
+static
+int range_scalar(const type_value_store *v, int n,
+                 type_value_store min, type_value_store max,
+                 enum TypeStatus *status)
+{
+    int failed = 0;
+
+    if (status == NULL){
+        /* just count, no stores in the loop */
+        for (int i=0; i < n; i++){
+            failed += (v[i] < min) | (v[i] > max);
+        }
+        return failed;
+    }
+
+    for (int i=0; i < n; i++){
+        bool out = (v[i] < min) | (v[i] > max);
+        status[i] = out ? TS_OUTRANGE : TS_OK;
+        failed += out;
+    }
+
+    return failed;
+}/* range_scalar */
+
+static
+int sum_scalar(type_value_store *out, enum TypeStatus *status,
+               const type_value_store *a, const type_value_store *b, int n,
+               type_value_store min, type_value_store max)
+{
+    int failed = 0;
+
+    for (int i=0; i < n; i++){
+        type_value_store v = 0;
+        bool overflow = __builtin_add_overflow(a[i], b[i], &v);
+        bool bad = overflow | (v < min) | (v > max);
+
+        out[i] = bad ? out[i] : v;
+        status[i] = bad ? TS_OUTRANGE : TS_OK;
+        failed += bad;
+    }
+
+    return failed;
+}/* sum_scalar */
+
+static
+int sum_sat_scalar(type_value_store *out, enum TypeStatus *status,
+                   const type_value_store *a, const type_value_store *b, int n,
+                   type_value_store min, type_value_store max)
+{
+    int saturated = 0;
+
+    for (int i=0; i < n; i++){
+        type_value_store v = 0;
+        bool overflow = __builtin_add_overflow(a[i], b[i], &v);
+        bool sat = false;
+
+        /* with overflow, the sign of b tells the direction */
+        out[i] = sat_clamp(v, overflow, b[i] < 0, min, max, &sat);
+        if (status != NULL){
+            status[i] = sat ? TS_OUTRANGE : TS_OK;
+        }
+        saturated += sat;
+    }
+
+    return saturated;
+}/* sum_sat_scalar */
+
+static
+int clamp_scalar(type_value_store *v, enum TypeStatus *status, int n,
+                 type_value_store min, type_value_store max)
+{
+    int saturated = 0;
+
+    for (int i=0; i < n; i++){
+        bool sat = (v[i] < min) | (v[i] > max);
+
+        v[i] = (v[i] < min) ? min : ((v[i] > max) ? max : v[i]);
+        if (status != NULL){
+            status[i] = sat ? TS_OUTRANGE : TS_OK;
+        }
+        saturated += sat;
+    }
+
+    return saturated;
+}/* clamp_scalar */
+
+static inline
+void reduce_add(struct ReducePart *p, type_value_store v)
+{
+    p->hi += v >> 32; /* arithmetic shift */
+    p->lo += v & 0xffffffffLL;
+    p->min = (v < p->min) ? v : p->min;
+    p->max = (v > p->max) ? v : p->max;
+}/* reduce_add */
+
+static
+void reduce_scalar(const type_value_store *v, int n, struct ReducePart *p)
+{
+    struct ReducePart q = *p; /* local, not aliased by v */
+
+    for (int i=0; i < n; i++){
+        reduce_add(&q, v[i]);
+    }
+
+    *p = q;
+}/* reduce_scalar */
+
+static
+int convert_scalar(type_value_store *out, enum TypeStatus *status,
+                   const type_value_store *v, int n, const struct TypeScale *s)
+{
+    int failed = 0;
+
+    for (int i=0; i < n; i++){
+        type_value_store x = 0;
+        enum TypeStatus st = store_scale(s, v[i], &x);
+        bool ok = (st == TS_OK);
+
+        out[i] = ok ? x : out[i];
+        status[i] = st;
+        failed += !ok;
+    }
+
+    return failed;
+}/* convert_scalar */
+
+#ifdef TYPE_X86_SIMD
+
+/* write the statuses from the bits of the lanes out of range */
+static inline
+void status_from_mask(enum TypeStatus *status, unsigned mask, int lanes)
+{
+    for (int k=0; k < lanes; k++){
+        status[k] = ((mask >> k) & 1) ? TS_OUTRANGE : TS_OK;
+    }
+}/* status_from_mask */
+
+/* Add the lanes of a vector reduction to the partial result.
+ * Without the arithmetic shift of 64 bits lanes (before AVX-512) the high
+ * halves are shifted logically and the negative values are counted apart:
+ * each one has 2^32 more in its high half.
+ */
+static inline
+void reduce_lanes(struct ReducePart *p, const type_value_store *hi,
+                  const type_value_store *lo, const type_value_store *neg,
+                  const type_value_store *min, const type_value_store *max,
+                  int lanes)
+{
+    for (int k=0; k < lanes; k++){
+        p->hi += hi[k] - neg[k] * (1LL << 32);
+        p->lo += lo[k];
+        p->min = (min[k] < p->min) ? min[k] : p->min;
+        p->max = (max[k] > p->max) ? max[k] : p->max;
+    }
+}/* reduce_lanes */
+
+/* SSE4.2: 2 lanes */
+
+__attribute__((target("sse4.2")))
+static
+int range_sse42(const type_value_store *v, int n,
+                type_value_store min, type_value_store max,
+                enum TypeStatus *status)
+{
+    const __m128i vmin = _mm_set1_epi64x(min);
+    const __m128i vmax = _mm_set1_epi64x(max);
+    int failed = 0;
+    int i = 0;
+
+    for (; i + 2 <= n; i += 2){
+        __m128i x = _mm_loadu_si128((const __m128i *)(v + i));
+        __m128i bad = _mm_or_si128(_mm_cmpgt_epi64(vmin, x),
+                                   _mm_cmpgt_epi64(x, vmax));
+        unsigned m = _mm_movemask_pd(_mm_castsi128_pd(bad));
+
+        failed += __builtin_popcount(m);
+        if (status != NULL){
+            status_from_mask(status + i, m, 2);
+        }
+    }
+
+    return failed + range_scalar(v + i, n - i, min, max,
+                                 status != NULL ? status + i : NULL);
+}/* range_sse42 */
+
+__attribute__((target("sse4.2")))
+static
+int sum_sse42(type_value_store *out, enum TypeStatus *status,
+              const type_value_store *a, const type_value_store *b, int n,
+              type_value_store min, type_value_store max)
+{
+    const __m128i vmin = _mm_set1_epi64x(min);
+    const __m128i vmax = _mm_set1_epi64x(max);
+    const __m128i zero = _mm_setzero_si128();
+    int failed = 0;
+    int i = 0;
+
+    for (; i + 2 <= n; i += 2){
+        __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+        __m128i old = _mm_loadu_si128((const __m128i *)(out + i));
+        __m128i sum = _mm_add_epi64(x, y);
+
+        /* signed overflow: the sign of the sum differs from both */
+        __m128i ovf = _mm_and_si128(_mm_xor_si128(x, sum),
+                                    _mm_xor_si128(y, sum));
+        __m128i bad = _mm_or_si128(_mm_cmpgt_epi64(zero, ovf),
+                                   _mm_or_si128(_mm_cmpgt_epi64(vmin, sum),
+                                                _mm_cmpgt_epi64(sum, vmax)));
+
+        _mm_storeu_si128((__m128i *)(out + i), _mm_blendv_epi8(sum, old, bad));
+
+        unsigned m = _mm_movemask_pd(_mm_castsi128_pd(bad));
+        failed += __builtin_popcount(m);
+        status_from_mask(status + i, m, 2);
+    }
+
+    return failed + sum_scalar(out + i, status + i, a + i, b + i, n - i,
+                               min, max);
+}/* sum_sse42 */
+
+__attribute__((target("sse4.2")))
+static
+int sum_sat_sse42(type_value_store *out, enum TypeStatus *status,
+                  const type_value_store *a, const type_value_store *b, int n,
+                  type_value_store min, type_value_store max)
+{
+    const __m128i vmin = _mm_set1_epi64x(min);
+    const __m128i vmax = _mm_set1_epi64x(max);
+    const __m128i zero = _mm_setzero_si128();
+    int saturated = 0;
+    int i = 0;
+
+    for (; i + 2 <= n; i += 2){
+        __m128i x = _mm_loadu_si128((const __m128i *)(a + i));
+        __m128i y = _mm_loadu_si128((const __m128i *)(b + i));
+        __m128i sum = _mm_add_epi64(x, y);
+
+        __m128i ovf = _mm_cmpgt_epi64(zero,
+                          _mm_and_si128(_mm_xor_si128(x, sum),
+                                        _mm_xor_si128(y, sum)));
+        __m128i low = _mm_cmpgt_epi64(vmin, sum);
+        __m128i high = _mm_cmpgt_epi64(sum, vmax);
+        __m128i limit = _mm_blendv_epi8(vmin, vmax, _mm_cmpgt_epi64(y, zero));
+
+        __m128i res = _mm_blendv_epi8(sum, vmin, low);
+        res = _mm_blendv_epi8(res, vmax, high);
+        res = _mm_blendv_epi8(res, limit, ovf);
+        _mm_storeu_si128((__m128i *)(out + i), res);
+
+        unsigned m = _mm_movemask_pd(_mm_castsi128_pd(
+                         _mm_or_si128(ovf, _mm_or_si128(low, high))));
+        saturated += __builtin_popcount(m);
+        if (status != NULL){
+            status_from_mask(status + i, m, 2);
+        }
+    }
+
+    return saturated + sum_sat_scalar(out + i,
+                                      status != NULL ? status + i : NULL,
+                                      a + i, b + i, n - i, min, max);
+}/* sum_sat_sse42 */
+
+__attribute__((target("sse4.2")))
+static
+int clamp_sse42(type_value_store *v, enum TypeStatus *status, int n,
+                type_value_store min, type_value_store max)
+{
+    const __m128i vmin = _mm_set1_epi64x(min);
+    const __m128i vmax = _mm_set1_epi64x(max);
+    int saturated = 0;
+    int i = 0;
+
+    for (; i + 2 <= n; i += 2){
+        __m128i x = _mm_loadu_si128((const __m128i *)(v + i));
+        __m128i low = _mm_cmpgt_epi64(vmin, x);
+        __m128i high = _mm_cmpgt_epi64(x, vmax);
+
+        x = _mm_blendv_epi8(x, vmin, low);
+        x = _mm_blendv_epi8(x, vmax, high);
+        _mm_storeu_si128((__m128i *)(v + i), x);
+
+        unsigned m = _mm_movemask_pd(_mm_castsi128_pd(_mm_or_si128(low, high)));
+        saturated += __builtin_popcount(m);
+        if (status != NULL){
+            status_from_mask(status + i, m, 2);
+        }
+    }
+
+    return saturated + clamp_scalar(v + i, status != NULL ? status + i : NULL,
+                                    n - i, min, max);
+}/* clamp_sse42 */
+
+__attribute__((target("sse4.2")))
+static
+void reduce_sse42(const type_value_store *v, int n, struct ReducePart *p)
+{
+    const __m128i low = _mm_set1_epi64x(0xffffffffLL);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i hi = zero;
+    __m128i lo = zero;
+    __m128i neg = zero;
+    __m128i vmin = _mm_set1_epi64x(p->min);
+    __m128i vmax = _mm_set1_epi64x(p->max);
+    int i = 0;
+
+    for (; i + 2 <= n; i += 2){
+        __m128i x = _mm_loadu_si128((const __m128i *)(v + i));
+
+        hi = _mm_add_epi64(hi, _mm_srli_epi64(x, 32));
+        lo = _mm_add_epi64(lo, _mm_and_si128(x, low));
+        neg = _mm_sub_epi64(neg, _mm_cmpgt_epi64(zero, x));
+        vmin = _mm_blendv_epi8(vmin, x, _mm_cmpgt_epi64(vmin, x));
+        vmax = _mm_blendv_epi8(vmax, x, _mm_cmpgt_epi64(x, vmax));
+    }
+
+    type_value_store h[2], l[2], g[2], mn[2], mx[2];
+    _mm_storeu_si128((__m128i *)h, hi);
+    _mm_storeu_si128((__m128i *)l, lo);
+    _mm_storeu_si128((__m128i *)g, neg);
+    _mm_storeu_si128((__m128i *)mn, vmin);
+    _mm_storeu_si128((__m128i *)mx, vmax);
+    reduce_lanes(p, h, l, g, mn, mx, 2);
+
+    reduce_scalar(v + i, n - i, p);
+}/* reduce_sse42 */
+
+/* AVX2: 4 lanes */
+
+__attribute__((target("avx2")))
+static
+int range_avx2(const type_value_store *v, int n,
+               type_value_store min, type_value_store max,
+               enum TypeStatus *status)
+{
+    const __m256i vmin = _mm256_set1_epi64x(min);
+    const __m256i vmax = _mm256_set1_epi64x(max);
+    int failed = 0;
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4){
+        __m256i x = _mm256_loadu_si256((const __m256i *)(v + i));
+        __m256i bad = _mm256_or_si256(_mm256_cmpgt_epi64(vmin, x),
+                                      _mm256_cmpgt_epi64(x, vmax));
+        unsigned m = _mm256_movemask_pd(_mm256_castsi256_pd(bad));
+
+        failed += __builtin_popcount(m);
+        if (status != NULL){
+            status_from_mask(status + i, m, 4);
+        }
+    }
+
+    return failed + range_scalar(v + i, n - i, min, max,
+                                 status != NULL ? status + i : NULL);
+}/* range_avx2 */
+
+__attribute__((target("avx2")))
+static
+int sum_avx2(type_value_store *out, enum TypeStatus *status,
+             const type_value_store *a, const type_value_store *b, int n,
+             type_value_store min, type_value_store max)
+{
+    const __m256i vmin = _mm256_set1_epi64x(min);
+    const __m256i vmax = _mm256_set1_epi64x(max);
+    const __m256i zero = _mm256_setzero_si256();
+    int failed = 0;
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4){
+        __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+        __m256i old = _mm256_loadu_si256((const __m256i *)(out + i));
+        __m256i sum = _mm256_add_epi64(x, y);
+
+        /* signed overflow: the sign of the sum differs from both */
+        __m256i ovf = _mm256_and_si256(_mm256_xor_si256(x, sum),
+                                       _mm256_xor_si256(y, sum));
+        __m256i bad = _mm256_or_si256(_mm256_cmpgt_epi64(zero, ovf),
+                          _mm256_or_si256(_mm256_cmpgt_epi64(vmin, sum),
+                                          _mm256_cmpgt_epi64(sum, vmax)));
+
+        _mm256_storeu_si256((__m256i *)(out + i),
+                            _mm256_blendv_epi8(sum, old, bad));
+
+        unsigned m = _mm256_movemask_pd(_mm256_castsi256_pd(bad));
+        failed += __builtin_popcount(m);
+        status_from_mask(status + i, m, 4);
+    }
+
+    return failed + sum_scalar(out + i, status + i, a + i, b + i, n - i,
+                               min, max);
+}/* sum_avx2 */
+
+__attribute__((target("avx2")))
+static
+int sum_sat_avx2(type_value_store *out, enum TypeStatus *status,
+                 const type_value_store *a, const type_value_store *b, int n,
+                 type_value_store min, type_value_store max)
+{
+    const __m256i vmin = _mm256_set1_epi64x(min);
+    const __m256i vmax = _mm256_set1_epi64x(max);
+    const __m256i zero = _mm256_setzero_si256();
+    int saturated = 0;
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4){
+        __m256i x = _mm256_loadu_si256((const __m256i *)(a + i));
+        __m256i y = _mm256_loadu_si256((const __m256i *)(b + i));
+        __m256i sum = _mm256_add_epi64(x, y);
+
+        __m256i ovf = _mm256_cmpgt_epi64(zero,
+                          _mm256_and_si256(_mm256_xor_si256(x, sum),
+                                           _mm256_xor_si256(y, sum)));
+        __m256i low = _mm256_cmpgt_epi64(vmin, sum);
+        __m256i high = _mm256_cmpgt_epi64(sum, vmax);
+        __m256i limit = _mm256_blendv_epi8(vmin, vmax,
+                                           _mm256_cmpgt_epi64(y, zero));
+
+        __m256i res = _mm256_blendv_epi8(sum, vmin, low);
+        res = _mm256_blendv_epi8(res, vmax, high);
+        res = _mm256_blendv_epi8(res, limit, ovf);
+        _mm256_storeu_si256((__m256i *)(out + i), res);
+
+        unsigned m = _mm256_movemask_pd(_mm256_castsi256_pd(
+                         _mm256_or_si256(ovf, _mm256_or_si256(low, high))));
+        saturated += __builtin_popcount(m);
+        if (status != NULL){
+            status_from_mask(status + i, m, 4);
+        }
+    }
+
+    return saturated + sum_sat_scalar(out + i,
+                                      status != NULL ? status + i : NULL,
+                                      a + i, b + i, n - i, min, max);
+}/* sum_sat_avx2 */
+
+__attribute__((target("avx2")))
+static
+int clamp_avx2(type_value_store *v, enum TypeStatus *status, int n,
+               type_value_store min, type_value_store max)
+{
+    const __m256i vmin = _mm256_set1_epi64x(min);
+    const __m256i vmax = _mm256_set1_epi64x(max);
+    int saturated = 0;
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4){
+        __m256i x = _mm256_loadu_si256((const __m256i *)(v + i));
+        __m256i low = _mm256_cmpgt_epi64(vmin, x);
+        __m256i high = _mm256_cmpgt_epi64(x, vmax);
+
+        x = _mm256_blendv_epi8(x, vmin, low);
+        x = _mm256_blendv_epi8(x, vmax, high);
+        _mm256_storeu_si256((__m256i *)(v + i), x);
+
+        unsigned m = _mm256_movemask_pd(_mm256_castsi256_pd(
+                         _mm256_or_si256(low, high)));
+        saturated += __builtin_popcount(m);
+        if (status != NULL){
+            status_from_mask(status + i, m, 4);
+        }
+    }
+
+    return saturated + clamp_scalar(v + i, status != NULL ? status + i : NULL,
+                                    n - i, min, max);
+}/* clamp_avx2 */
+
+__attribute__((target("avx2")))
+static
+void reduce_avx2(const type_value_store *v, int n, struct ReducePart *p)
+{
+    const __m256i low = _mm256_set1_epi64x(0xffffffffLL);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i hi = zero;
+    __m256i lo = zero;
+    __m256i neg = zero;
+    __m256i vmin = _mm256_set1_epi64x(p->min);
+    __m256i vmax = _mm256_set1_epi64x(p->max);
+    int i = 0;
+
+    for (; i + 4 <= n; i += 4){
+        __m256i x = _mm256_loadu_si256((const __m256i *)(v + i));
+
+        hi = _mm256_add_epi64(hi, _mm256_srli_epi64(x, 32));
+        lo = _mm256_add_epi64(lo, _mm256_and_si256(x, low));
+        neg = _mm256_sub_epi64(neg, _mm256_cmpgt_epi64(zero, x));
+        vmin = _mm256_blendv_epi8(vmin, x, _mm256_cmpgt_epi64(vmin, x));
+        vmax = _mm256_blendv_epi8(vmax, x, _mm256_cmpgt_epi64(x, vmax));
+    }
+
+    type_value_store h[4], l[4], g[4], mn[4], mx[4];
+    _mm256_storeu_si256((__m256i *)h, hi);
+    _mm256_storeu_si256((__m256i *)l, lo);
+    _mm256_storeu_si256((__m256i *)g, neg);
+    _mm256_storeu_si256((__m256i *)mn, vmin);
+    _mm256_storeu_si256((__m256i *)mx, vmax);
+    reduce_lanes(p, h, l, g, mn, mx, 4);
+
+    reduce_scalar(v + i, n - i, p);
+}/* reduce_avx2 */
+
+/* AVX-512F: 8 lanes */
+
+__attribute__((target("avx512f")))
+static
+int range_avx512(const type_value_store *v, int n,
+                 type_value_store min, type_value_store max,
+                 enum TypeStatus *status)
+{
+    const __m512i vmin = _mm512_set1_epi64(min);
+    const __m512i vmax = _mm512_set1_epi64(max);
+    int failed = 0;
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8){
+        __m512i x = _mm512_loadu_si512((const void *)(v + i));
+        unsigned m = _mm512_cmpgt_epi64_mask(vmin, x) |
+                     _mm512_cmpgt_epi64_mask(x, vmax);
+
+        failed += __builtin_popcount(m);
+        if (status != NULL){
+            status_from_mask(status + i, m, 8);
+        }
+    }
+
+    return failed + range_scalar(v + i, n - i, min, max,
+                                 status != NULL ? status + i : NULL);
+}/* range_avx512 */
+
+__attribute__((target("avx512f")))
+static
+int sum_avx512(type_value_store *out, enum TypeStatus *status,
+               const type_value_store *a, const type_value_store *b, int n,
+               type_value_store min, type_value_store max)
+{
+    const __m512i vmin = _mm512_set1_epi64(min);
+    const __m512i vmax = _mm512_set1_epi64(max);
+    const __m512i zero = _mm512_setzero_si512();
+    int failed = 0;
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8){
+        __m512i x = _mm512_loadu_si512((const void *)(a + i));
+        __m512i y = _mm512_loadu_si512((const void *)(b + i));
+        __m512i sum = _mm512_add_epi64(x, y);
+
+        /* signed overflow: the sign of the sum differs from both */
+        __m512i ovf = _mm512_and_si512(_mm512_xor_si512(x, sum),
+                                       _mm512_xor_si512(y, sum));
+        __mmask8 bad = _mm512_cmplt_epi64_mask(ovf, zero) |
+                       _mm512_cmpgt_epi64_mask(vmin, sum) |
+                       _mm512_cmpgt_epi64_mask(sum, vmax);
+
+        /* store only the good lanes */
+        _mm512_mask_storeu_epi64((void *)(out + i), (__mmask8)~bad, sum);
+
+        failed += __builtin_popcount(bad);
+        status_from_mask(status + i, bad, 8);
+    }
+
+    return failed + sum_scalar(out + i, status + i, a + i, b + i, n - i,
+                               min, max);
+}/* sum_avx512 */
+
+__attribute__((target("avx512f")))
+static
+int sum_sat_avx512(type_value_store *out, enum TypeStatus *status,
+                   const type_value_store *a, const type_value_store *b, int n,
+                   type_value_store min, type_value_store max)
+{
+    const __m512i vmin = _mm512_set1_epi64(min);
+    const __m512i vmax = _mm512_set1_epi64(max);
+    const __m512i zero = _mm512_setzero_si512();
+    int saturated = 0;
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8){
+        __m512i x = _mm512_loadu_si512((const void *)(a + i));
+        __m512i y = _mm512_loadu_si512((const void *)(b + i));
+        __m512i sum = _mm512_add_epi64(x, y);
+
+        __mmask8 ovf = _mm512_cmplt_epi64_mask(
+                           _mm512_and_si512(_mm512_xor_si512(x, sum),
+                                            _mm512_xor_si512(y, sum)),
+                           zero);
+        __mmask8 sat = ovf |
+                       _mm512_cmpgt_epi64_mask(vmin, sum) |
+                       _mm512_cmpgt_epi64_mask(sum, vmax);
+        __m512i limit = _mm512_mask_blend_epi64(
+                            _mm512_cmpgt_epi64_mask(y, zero), vmin, vmax);
+
+        __m512i res = _mm512_min_epi64(_mm512_max_epi64(sum, vmin), vmax);
+        res = _mm512_mask_blend_epi64(ovf, res, limit);
+        _mm512_storeu_si512((void *)(out + i), res);
+
+        saturated += __builtin_popcount(sat);
+        if (status != NULL){
+            status_from_mask(status + i, sat, 8);
+        }
+    }
+
+    return saturated + sum_sat_scalar(out + i,
+                                      status != NULL ? status + i : NULL,
+                                      a + i, b + i, n - i, min, max);
+}/* sum_sat_avx512 */
+
+__attribute__((target("avx512f")))
+static
+int clamp_avx512(type_value_store *v, enum TypeStatus *status, int n,
+                 type_value_store min, type_value_store max)
+{
+    const __m512i vmin = _mm512_set1_epi64(min);
+    const __m512i vmax = _mm512_set1_epi64(max);
+    int saturated = 0;
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8){
+        __m512i x = _mm512_loadu_si512((const void *)(v + i));
+        __mmask8 sat = _mm512_cmpgt_epi64_mask(vmin, x) |
+                       _mm512_cmpgt_epi64_mask(x, vmax);
+
+        x = _mm512_min_epi64(_mm512_max_epi64(x, vmin), vmax);
+        _mm512_storeu_si512((void *)(v + i), x);
+
+        saturated += __builtin_popcount(sat);
+        if (status != NULL){
+            status_from_mask(status + i, sat, 8);
+        }
+    }
+
+    return saturated + clamp_scalar(v + i, status != NULL ? status + i : NULL,
+                                    n - i, min, max);
+}/* clamp_avx512 */
+
+__attribute__((target("avx512f")))
+static
+void reduce_avx512(const type_value_store *v, int n, struct ReducePart *p)
+{
+    const __m512i low = _mm512_set1_epi64(0xffffffffLL);
+    const __m512i zero = _mm512_setzero_si512();
+    __m512i hi = zero;
+    __m512i lo = zero;
+    __m512i vmin = _mm512_set1_epi64(p->min);
+    __m512i vmax = _mm512_set1_epi64(p->max);
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8){
+        __m512i x = _mm512_loadu_si512((const void *)(v + i));
+
+        hi = _mm512_add_epi64(hi, _mm512_srai_epi64(x, 32));
+        lo = _mm512_add_epi64(lo, _mm512_and_si512(x, low));
+        vmin = _mm512_min_epi64(vmin, x);
+        vmax = _mm512_max_epi64(vmax, x);
+    }
+
+    type_value_store h[8], l[8], mn[8], mx[8];
+    const type_value_store g[8] = {0}; /* the shift is arithmetic */
+    _mm512_storeu_si512((void *)h, hi);
+    _mm512_storeu_si512((void *)l, lo);
+    _mm512_storeu_si512((void *)mn, vmin);
+    _mm512_storeu_si512((void *)mx, vmax);
+    reduce_lanes(p, h, l, g, mn, mx, 8);
+
+    reduce_scalar(v + i, n - i, p);
+}/* reduce_avx512 */
+
+/* The quotient is estimated in double (AVX-512DQ), that is exact up to one
+ * unit when |v * mul| < 2^52, and fixed with the remainder.
+ * The blocks with a bigger product go through the scalar kernel.
+ */
+__attribute__((target("avx512f,avx512dq")))
+static
+int convert_avx512(type_value_store *out, enum TypeStatus *status,
+                   const type_value_store *v, int n, const struct TypeScale *s)
+{
+    const __m512i vmin = _mm512_set1_epi64(s->inMin);
+    const __m512i vmax = _mm512_set1_epi64(s->inMax);
+    const __m512i fmin = _mm512_set1_epi64(s->fastMin);
+    const __m512i fmax = _mm512_set1_epi64(s->fastMax);
+    const __m512i mul = _mm512_set1_epi64(s->mul);
+    const __m512i div = _mm512_set1_epi64(s->div);
+    const __m512i ndiv = _mm512_set1_epi64(-s->div);
+    const __m512i cut = _mm512_set1_epi64(s->cut);
+    const __m512i exact = _mm512_set1_epi64(1LL << 52);
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i one = _mm512_set1_epi64(1);
+    const __m512d ddiv = _mm512_set1_pd((double)s->div);
+    int failed = 0;
+    int i = 0;
+
+    for (; i + 8 <= n; i += 8){
+        __m512i x = _mm512_loadu_si512((const void *)(v + i));
+        __mmask8 bad = _mm512_cmpgt_epi64_mask(vmin, x) |
+                       _mm512_cmpgt_epi64_mask(x, vmax);
+
+        __mmask8 slow = ~bad & (_mm512_cmpgt_epi64_mask(fmin, x) |
+                                _mm512_cmpgt_epi64_mask(x, fmax));
+
+        /* the lanes out of range are 0, no overflow */
+        __m512i p = _mm512_mullo_epi64(_mm512_maskz_mov_epi64(~bad, x), mul);
+
+        if (slow != 0 ||
+            _mm512_cmpge_epi64_mask(_mm512_abs_epi64(p), exact) != 0){
+            failed += convert_scalar(out + i, status + i, v + i, 8, s);
+            continue;
+        }
+
+        __m512i q = _mm512_cvttpd_epi64(
+                        _mm512_div_pd(_mm512_cvtepi64_pd(p), ddiv));
+        __m512i r = _mm512_sub_epi64(p, _mm512_mullo_epi64(q, div));
+
+        /* truncation: r has the sign of p and |r| < div */
+        __mmask8 neg = _mm512_cmplt_epi64_mask(p, zero);
+        __mmask8 up = (~neg & _mm512_cmpge_epi64_mask(r, div)) |
+                      (neg & _mm512_cmpgt_epi64_mask(r, zero));
+        __mmask8 down = (~neg & _mm512_cmplt_epi64_mask(r, zero)) |
+                        (neg & _mm512_cmple_epi64_mask(r, ndiv));
+        q = _mm512_mask_add_epi64(q, up, q, one);
+        q = _mm512_mask_sub_epi64(q, down, q, one);
+
+        /* store only the good lanes */
+        _mm512_mask_storeu_epi64((void *)(out + i), (__mmask8)~bad,
+                                 _mm512_mullo_epi64(q, cut));
+
+        failed += __builtin_popcount(bad);
+        status_from_mask(status + i, bad, 8);
+    }
+
+    return failed + convert_scalar(out + i, status + i, v + i, n - i, s);
+}/* convert_avx512 */
+
+#endif /* TYPE_X86_SIMD */
+
+/* one table per level, switched with an atomic pointer so a column
+ * operation running in another thread sees one whole table or the other
+ */
+static const struct SimdKernels simdScalar = {
+    TYPE_SIMD_SCALAR, range_scalar, sum_scalar, sum_sat_scalar,
+    clamp_scalar, reduce_scalar, convert_scalar
+};
+#ifdef TYPE_X86_SIMD
+static const struct SimdKernels simdSse42 = {
+    TYPE_SIMD_SSE42, range_sse42, sum_sse42, sum_sat_sse42,
+    clamp_sse42, reduce_sse42, convert_scalar
+};
+static const struct SimdKernels simdAvx2 = {
+    TYPE_SIMD_AVX2, range_avx2, sum_avx2, sum_sat_avx2,
+    clamp_avx2, reduce_avx2, convert_scalar
+};
+static const struct SimdKernels simdAvx512 = {
+    TYPE_SIMD_AVX512, range_avx512, sum_avx512, sum_sat_avx512,
+    clamp_avx512, reduce_avx512, convert_scalar
+};
+static const struct SimdKernels simdAvx512dq = {
+    TYPE_SIMD_AVX512, range_avx512, sum_avx512, sum_sat_avx512,
+    clamp_avx512, reduce_avx512, convert_avx512
+};
+#endif
+
+/* NULL until the first use, see simd_kernels() */
+static const struct SimdKernels *simd = NULL;
+
+/* the best level supported by the CPU */
+static
+enum TypeSimd simd_supported(void)
+{
+#ifdef TYPE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")){
+        return TYPE_SIMD_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2")){
+        return TYPE_SIMD_AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.2")){
+        return TYPE_SIMD_SSE42;
+    }
+#endif
+    return TYPE_SIMD_SCALAR;
+}/* simd_supported */
+
+/* the kernels of a level supported by the CPU */
+static
+const struct SimdKernels *simd_table(enum TypeSimd level)
+{
+    const struct SimdKernels *k = &simdScalar;
+#ifdef TYPE_X86_SIMD
+    /* before AVX-512DQ there is no 64 bits multiplication nor conversion
+     * to double, the conversion stays scalar
+     */
+    switch (level){
+    case TYPE_SIMD_AVX512:
+        k = __builtin_cpu_supports("avx512dq") ? &simdAvx512dq : &simdAvx512;
+        break;
+    case TYPE_SIMD_AVX2:
+        k = &simdAvx2;
+        break;
+    case TYPE_SIMD_SSE42:
+        k = &simdSse42;
+        break;
+    default:
+        break;
+    }/* switch */
+#else
+    (void)level;
+#endif
+
+    return k;
+}/* simd_table */
+
+/* the first use picks the best level, unless type_simd_set came first */
+static
+const struct SimdKernels *simd_choose(void)
+{
+    const struct SimdKernels *k = simd_table(simd_supported());
+    const struct SimdKernels *none = NULL;
+
+    if (__atomic_compare_exchange_n(&simd, &none, k, false,
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+        return k;
+    }
+    return none; /* set by another thread */
+}/* simd_choose */
+
+static inline
+const struct SimdKernels *simd_kernels(void)
+{
+    const struct SimdKernels *k = __atomic_load_n(&simd, __ATOMIC_ACQUIRE);
+
+    return __builtin_expect(k != NULL, 1) ? k : simd_choose();
+}/* simd_kernels */
+
+enum TypeSimd type_simd_set(enum TypeSimd level)
+{
+    assert(level >= TYPE_SIMD_SCALAR && level <= TYPE_SIMD_AVX512);
+
+    enum TypeSimd best = simd_supported();
+    if (level > best){
+        level = best;
+    }
+
+    __atomic_store_n(&simd, simd_table(level), __ATOMIC_RELEASE);
+    return level;
+}/* type_simd_set */
+
+enum TypeSimd type_simd(void)
+{
+    return simd_kernels()->level;
+}/* type_simd */
+
+/* Columns */
+
+static
+size_t column_round(size_t bytes)
+{
+    return (bytes + TYPE_COLUMN_ALIGN - 1) & ~((size_t)TYPE_COLUMN_ALIGN - 1);
+}/* column_round */
+
+size_t type_column_size(int len)
+{
+    assert(len >= 0);
+
+    size_t size = TYPE_COLUMN_ALIGN; /* room for aligning the memory start */
+    size += column_round((size_t)len * sizeof(type_value_store));
+#ifdef TYPE_TIMESTAMP
+    size += column_round((size_t)len * sizeof(type_millisecs));
+#endif
+    return size;
+}/* type_column_size */
+
+TypeColumn type_column(int type, void *mem, int len)
+{
+    assert(validate_type(type_table(), type));
+    assert(mem != NULL);
+    assert(len >= 0);
+
+    memset(mem, 0, type_column_size(len));
+
+    uintptr_t start = (uintptr_t)mem;
+    start = (start + TYPE_COLUMN_ALIGN - 1) & ~((uintptr_t)TYPE_COLUMN_ALIGN - 1);
+
+    TypeColumn col = {.type = type, .len = len};
+    col.values = (type_value_store *)start;
+#ifdef TYPE_TIMESTAMP
+    start += column_round((size_t)len * sizeof(type_value_store));
+    col.timestamps = (type_millisecs *)start;
+#endif
+    return col;
+}/* type_column */
+
+TypeValue type_column_get(const TypeColumn *col, int i)
+{
+    assert(col != NULL);
+    assert(i >= 0 && i < col->len);
+
+    TypeValue t = {.type = col->type, .value = col->values[i]};
+#ifdef TYPE_TIMESTAMP
+    t.timestamp = col->timestamps[i];
+#endif
+    return t;
+}/* type_column_get */
+
+enum TypeStatus type_column_put(TypeColumn *col, int i, const TypeValue tv)
+{
+    assert(col != NULL);
+    assert(i >= 0 && i < col->len);
+    assert(validate_value(type_table(), tv));
+
+    if (tv.type != col->type){
+        return TS_INCOMPATIBLE;
+    }
+
+    col->values[i] = tv.value;
+#ifdef TYPE_TIMESTAMP
+    col->timestamps[i] = tv.timestamp;
+#endif
+    return TS_OK;
+}/* type_column_put */
+
+/* mark all the column as failed, nothing is stored */
+static
+int column_fail(enum TypeStatus *status, int len, enum TypeStatus st)
+{
+    for (int i=0; i < len; i++){
+        status[i] = st;
+    }
+
+    return len;
+}/* column_fail */
+
+int type_column_set(TypeColumn *col, enum TypeStatus *status,
+                    const type_value_store *v)
+{
+    PROFILE(TYPE_PROF_COLUMN_SET, col->type);
+
+    const struct TypeTable *tt = type_table();
+
+    assert(col != NULL);
+    assert(validate_type(tt, col->type));
+
+    const struct TypeDesc *c = &tt->desc[col->type];
+    const type_value_store min = c->rangeMin;
+    const type_value_store max = c->rangeMax;
+    int failed = 0;
+#ifdef TYPE_TIMESTAMP
+    const type_millisecs now = type_stamp();
+#endif
+
+    for (int i=0; i < col->len; i++){
+        type_value_store x = desc_cut(c, v[i]); /* enforce precision */
+        bool ok = (x >= min) && (x <= max);
+
+        col->values[i] = ok ? x : col->values[i];
+#ifdef TYPE_TIMESTAMP
+        col->timestamps[i] = ok ? now : col->timestamps[i];
+#endif
+        status[i] = ok ? TS_OK : TS_OUTRANGE;
+        failed += !ok;
+    }
+
+    return failed;
+}/* type_column_set */
+
+int type_column_parse(TypeColumn *col, enum TypeStatus *status,
+                      const char *text, int len, char sep)
+{
+    PROFILE(TYPE_PROF_COLUMN_PARSE, col->type);
+
+    const struct TypeTable *tt = type_table();
+
+    assert(col != NULL);
+    assert(validate_type(tt, col->type));
+    assert(text != NULL);
+
+    const struct TypeDesc *c = &tt->desc[col->type];
+    int pos = 0;
+    int count = 0;
+#ifdef TYPE_TIMESTAMP
+    const type_millisecs now = type_stamp();
+#endif
+
+    while (pos < len && count < col->len){
+        const char *field = NULL;
+        int flen = 0;
+        type_value_store v = 0;
+
+        pos = parse_field(text, pos, len, sep, &field, &flen);
+        status[count] = parse_value(c, field, flen, &v);
+
+        if (status[count] == TS_OK){
+            col->values[count] = v;
+#ifdef TYPE_TIMESTAMP
+            col->timestamps[count] = now;
+#endif
+        }
+        count++;
+    }
+
+    return count;
+}/* type_column_parse */
+
+/* Apply the kernel to the whole columns.
+ * Only the results with TS_OK are stored, the others keep the old value.
+ */
+static inline
+int column_apply(const struct TypeDesc *c, TypeColumn *out,
+                 enum TypeStatus *status,
+                 const TypeColumn *a, const TypeColumn *b,
+                 store_kernel kernel)
+{
+    const type_value_store *va = a->values;
+    const type_value_store *vb = b->values;
+    int failed = 0;
+#ifdef TYPE_TIMESTAMP
+    const type_millisecs now = type_stamp();
+#endif
+
+    for (int i=0; i < out->len; i++){
+        type_value_store v = 0;
+        enum TypeStatus st = kernel(c, va[i], vb[i], &v);
+        bool ok = (st == TS_OK);
+
+        out->values[i] = ok ? v : out->values[i];
+#ifdef TYPE_TIMESTAMP
+        out->timestamps[i] = ok ? now : out->timestamps[i];
+#endif
+        status[i] = st;
+        failed += !ok;
+    }
+
+    return failed;
+}/* column_apply */
+
+/* common checks of the column operations,
+ * return the type of the columns or NULL if they are not compatible
+ */
+static
+const struct TypeDesc *column_desc(const TypeColumn *out,
+                                   const TypeColumn *a, const TypeColumn *b)
+{
+    const struct TypeTable *tt = type_table();
+
+    assert(out != NULL && a != NULL && b != NULL);
+    assert(a->len == out->len && b->len == out->len);
+    assert(validate_type(tt, out->type));
+
+    if (a->type != out->type || b->type != out->type){
+        return NULL;
+    }
+
+    return &tt->desc[out->type];
+}/* column_desc */
+
+/* the category for the switch, -1 if not compatible */
+static inline
+int desc_category(const struct TypeDesc *c)
+{
+    return (c != NULL) ? (int)c->category : -1;
+}/* desc_category */
+
+#ifdef TYPE_TIMESTAMP
+/* set the timestamps of the elements with TS_OK, of all if status is NULL */
+static
+void stamp_array(type_millisecs *timestamps, int len,
+                 const enum TypeStatus *status)
+{
+    const type_millisecs now = type_stamp();
+
+    if (status == NULL){
+        for (int i=0; i < len; i++){
+            timestamps[i] = now;
+        }
+        return;
+    }
+
+    for (int i=0; i < len; i++){
+        timestamps[i] = (status[i] == TS_OK) ? now : timestamps[i];
+    }
+}/* stamp_array */
+#endif
+
+static
+void column_stamp(TypeColumn *col, const enum TypeStatus *status)
+{
+#ifdef TYPE_TIMESTAMP
+    stamp_array(col->timestamps, col->len, status);
+#else
+    (void)col;
+    (void)status;
+#endif
+}/* column_stamp */
+
+int type_column_sum(TypeColumn *out, enum TypeStatus *status,
+                    const TypeColumn *a, const TypeColumn *b)
+{
+    PROFILE(TYPE_PROF_COLUMN_SUM, out->type);
+
+    const struct TypeDesc *c = column_desc(out, a, b);
+    int failed = 0;
+
+    switch (desc_category(c)){
+    case INTEGER: /* fall through */
+    case DECIMAL:
+        failed = simd_kernels()->sum(out->values, status, a->values,
+                                     b->values, out->len,
+                                     c->rangeMin, c->rangeMax);
+        column_stamp(out, status);
+        STATS_COUNT_N(TYPE_OP_SUM, out->type, out->len, failed, 0);
+        return failed;
+    default:
+        STATS_COUNT_N(TYPE_OP_SUM, out->type, out->len, 0, out->len);
+        return column_fail(status, out->len, TS_INCOMPATIBLE);
+    }/* switch */
+}/* type_column_sum */
+
+int type_column_sum_sat(TypeColumn *out, enum TypeStatus *status,
+                        const TypeColumn *a, const TypeColumn *b)
+{
+    PROFILE(TYPE_PROF_COLUMN_SUM_SAT, out->type);
+
+    const struct TypeDesc *c = column_desc(out, a, b);
+    int saturated = 0;
+
+    switch (desc_category(c)){
+    case INTEGER: /* fall through */
+    case DECIMAL:
+        saturated = simd_kernels()->sum_sat(out->values, status, a->values,
+                                            b->values, out->len,
+                                            c->rangeMin, c->rangeMax);
+        column_stamp(out, NULL);
+        STATS_COUNT_N(TYPE_OP_SUM_SAT, out->type, out->len, saturated, 0);
+        return saturated;
+    default:
+        STATS_COUNT_N(TYPE_OP_SUM_SAT, out->type, out->len, 0, out->len);
+        return column_fail(status, out->len, TS_INCOMPATIBLE);
+    }/* switch */
+}/* type_column_sum_sat */
+
+int type_column_mul(TypeColumn *out, enum TypeStatus *status,
+                    const TypeColumn *a, const TypeColumn *b)
+{
+    PROFILE(TYPE_PROF_COLUMN_MUL, out->type);
+
+    const struct TypeDesc *c = column_desc(out, a, b);
+    int failed = 0;
+
+    switch (desc_category(c)){
+    case INTEGER:
+        failed = column_apply(c, out, status, a, b, store_imul);
+        break;
+    case DECIMAL:
+        failed = column_apply(c, out, status, a, b, store_dmul);
+        break;
+    default:
+        STATS_COUNT_N(TYPE_OP_MUL, out->type, out->len, 0, out->len);
+        return column_fail(status, out->len, TS_INCOMPATIBLE);
+    }/* switch */
+
+    STATS_COUNT_N(TYPE_OP_MUL, out->type, out->len, failed, 0);
+    return failed;
+}/* type_column_mul */
+
+int type_column_div(TypeColumn *out, enum TypeStatus *status,
+                    const TypeColumn *a, const TypeColumn *b)
+{
+    PROFILE(TYPE_PROF_COLUMN_DIV, out->type);
+
+    const struct TypeDesc *c = column_desc(out, a, b);
+    int failed = 0;
+
+    switch (desc_category(c)){
+    case INTEGER:
+        failed = column_apply(c, out, status, a, b, store_idiv);
+        break;
+    case DECIMAL:
+        failed = column_apply(c, out, status, a, b, store_ddiv_checked);
+        break;
+    default:
+        STATS_COUNT_N(TYPE_OP_DIV, out->type, out->len, 0, out->len);
+        return column_fail(status, out->len, TS_INCOMPATIBLE);
+    }/* switch */
+
+    STATS_COUNT_N(TYPE_OP_DIV, out->type, out->len, failed, 0);
+    return failed;
+}/* type_column_div */
+
+int type_column_validate(const TypeColumn *col, enum TypeStatus *status)
+{
+    PROFILE(TYPE_PROF_COLUMN_VALIDATE, col->type);
+
+    const struct TypeTable *tt = type_table();
+
+    assert(col != NULL);
+    assert(validate_type(tt, col->type));
+
+    const struct TypeDesc *c = &tt->desc[col->type];
+
+    return simd_kernels()->range(col->values, col->len,
+                                 c->rangeMin, c->rangeMax, status);
+}/* type_column_validate */
+
+int type_column_clamp(TypeColumn *col, enum TypeStatus *status)
+{
+    PROFILE(TYPE_PROF_COLUMN_CLAMP, col->type);
+
+    const struct TypeTable *tt = type_table();
+
+    assert(col != NULL);
+    assert(validate_type(tt, col->type));
+
+    const struct TypeDesc *c = &tt->desc[col->type];
+
+    return simd_kernels()->clamp(col->values, status, col->len,
+                                 c->rangeMin, c->rangeMax);
+}/* type_column_clamp */
+
+int type_column_convert(TypeColumn *out, enum TypeStatus *status,
+                        const struct TypeScale *s, const TypeColumn *in)
+{
+    PROFILE(TYPE_PROF_COLUMN_CONVERT, out->type);
+
+    const struct TypeTable *tt = type_table();
+
+    assert(out != NULL && in != NULL && s != NULL);
+    assert(in->len == out->len);
+    assert(validate_type(tt, s->from) && validate_type(tt, s->to));
+
+    if (in->type != s->from || out->type != s->to || !scale_valid(tt, s)){
+        STATS_COUNT_N(TYPE_OP_CONVERT, in->type, out->len, 0, out->len);
+        return column_fail(status, out->len, TS_INCOMPATIBLE);
+    }
+
+    int failed = simd_kernels()->convert(out->values, status, in->values,
+                                         out->len, s);
+    column_stamp(out, status);
+    STATS_COUNT_N(TYPE_OP_CONVERT, in->type, out->len, failed, 0);
+    return failed;
+}/* type_column_convert */
+
+/* Reductions */
+
+static
+void reduce_init(struct ReducePart *p)
+{
+    p->hi = 0;
+    p->lo = 0;
+    p->min = LLONG_MAX;
+    p->max = LLONG_MIN;
+}/* reduce_init */
+
+static
+void reduce_merge(struct ReducePart *p, const struct ReducePart *q)
+{
+    p->hi += q->hi;
+    p->lo += q->lo;
+    p->min = (q->min < p->min) ? q->min : p->min;
+    p->max = (q->max > p->max) ? q->max : p->max;
+}/* reduce_merge */
+
+/* a failed reduction, all the values are zero */
+static
+struct TypeReduction reduce_fail(int type, int count, enum TypeStatus st)
+{
+    TypeValue t = {.type = type, .value = 0};
+#ifdef TYPE_TIMESTAMP
+    t.timestamp = type_stamp();
+#endif
+    struct TypeReduction r = {.status = st, .count = count,
+                              .total = t, .min = t, .max = t, .mean = t};
+    return r;
+}/* reduce_fail */
+
+/* the total checked on the range, the mean truncated to the precision */
+static
+struct TypeReduction reduce_result(const struct TypeDesc *c, int type,
+                                   const struct ReducePart *p, int count)
+{
+    struct TypeReduction r = reduce_fail(type, count, TS_OK);
+
+    /* lo in [0, 2^32) with the carry in hi, so hi * 2^32 + lo fits 64 bits
+     * when hi * 2^32 does
+     */
+    type_value_store hi = p->hi + (p->lo >> 32);
+    type_value_store lo = p->lo & 0xffffffffLL;
+    type_value_store total = 0;
+    type_value_store mean = 0;
+    bool overflow = __builtin_mul_overflow(hi, 1LL << 32, &total);
+    total += overflow ? 0 : lo;
+
+#ifdef TYPE_WIDE
+    type_wide wide = (type_wide)hi * ((type_wide)1 << 32) + lo;
+    mean = (type_value_store)(wide / count);
+#else
+    if (!overflow){
+        mean = total / count;
+    } else {
+        long double ld = ((long double)hi * 4294967296.0L + lo) / count;
+        mean = (type_value_store)ld;
+    }
+#endif
+
+    r.status = (overflow || !store_in_range(c, total)) ? TS_OUTRANGE : TS_OK;
+    r.total.value = (r.status == TS_OK) ? total : 0;
+    r.min.value = p->min;
+    r.max.value = p->max;
+    r.mean.value = desc_cut(c, mean); /* between min and max, it fits */
+
+    return r;
+}/* reduce_result */
+
+struct TypeReduction type_reduce_n(const TypeValue *v, int n)
+{
+    PROFILE(TYPE_PROF_REDUCE_N, (n > 0) ? v[0].type : -1);
+
+    const struct TypeTable *tt = type_table();
+
+    assert(v != NULL);
+    assert(n > 0);
+    assert(validate_type(tt, v[0].type));
+
+    const int type = v[0].type;
+    const struct TypeDesc *c = &tt->desc[type];
+    struct ReducePart p;
+    bool mixed = false;
+
+    reduce_init(&p);
+    for (int i=0; i < n; i++){
+        assert(validate_value(tt, v[i]));
+
+        mixed |= (v[i].type != type);
+        reduce_add(&p, v[i].value);
+    }
+
+    if (mixed || c->category == NOMINAL){
+        return reduce_fail(type, n, TS_INCOMPATIBLE);
+    }
+
+    return reduce_result(c, type, &p, n);
+}/* type_reduce_n */
+
+struct TypeReduction type_column_reduce(const TypeColumn *col)
+{
+    PROFILE(TYPE_PROF_COLUMN_REDUCE, col->type);
+
+    const struct TypeTable *tt = type_table();
+
+    assert(col != NULL);
+    assert(col->len > 0);
+    assert(validate_type(tt, col->type));
+
+    const struct TypeDesc *c = &tt->desc[col->type];
+    struct ReducePart p;
+
+    if (c->category == NOMINAL){
+        return reduce_fail(col->type, col->len, TS_INCOMPATIBLE);
+    }
+
+    reduce_init(&p);
+    simd_kernels()->reduce(col->values, col->len, &p);
+
+    return reduce_result(c, col->type, &p, col->len);
+}/* type_column_reduce */
+
+/* a slice of the column for a thread */
+struct ReduceTask {
+    const type_value_store *v;
+    int n;
+    struct ReducePart part;
+};
+
+static
+void *reduce_task(void *arg)
+{
+    struct ReduceTask *t = arg;
+
+    simd_kernels()->reduce(t->v, t->n, &t->part);
+    return NULL;
+}/* reduce_task */
+
+struct TypeReduction type_column_reduce_mt(const TypeColumn *col, int threads)
+{
+    PROFILE(TYPE_PROF_COLUMN_REDUCE_MT, col->type);
+
+    const struct TypeTable *tt = type_table();
+
+    assert(col != NULL);
+    assert(col->len > 0);
+    assert(threads > 0);
+    assert(validate_type(tt, col->type));
+
+    const struct TypeDesc *c = &tt->desc[col->type];
+
+    if (c->category == NOMINAL){
+        return reduce_fail(col->type, col->len, TS_INCOMPATIBLE);
+    }
+
+    /* not worth a thread for less than a few pages */
+    const int minSlice = 4096;
+    if (threads > col->len / minSlice){
+        threads = (col->len / minSlice > 0) ? col->len / minSlice : 1;
+    }
+
+    struct ReduceTask *tasks = malloc(sizeof(struct ReduceTask) * threads);
+    pthread_t *tids = malloc(sizeof(pthread_t) * threads);
+    bool *started = malloc(sizeof(bool) * threads);
+    if (tasks == NULL || tids == NULL || started == NULL){
+        err(EXIT_FAILURE, "Cannot allocate the reduction threads");
+    }
+
+    const int slice = col->len / threads;
+    for (int k=0; k < threads; k++){
+        tasks[k].v = col->values + (size_t)k * slice;
+        tasks[k].n = (k == threads - 1) ? col->len - k * slice : slice;
+        reduce_init(&tasks[k].part);
+    }
+
+    /* the first slice in the calling thread, the others in new threads;
+     * a slice without thread is done here too
+     */
+    for (int k=1; k < threads; k++){
+        started[k] = (pthread_create(&tids[k], NULL, reduce_task,
+                                     &tasks[k]) == 0);
+    }
+    reduce_task(&tasks[0]);
+
+    struct ReducePart p = tasks[0].part;
+    for (int k=1; k < threads; k++){
+        if (started[k]){
+            pthread_join(tids[k], NULL);
+        } else {
+            reduce_task(&tasks[k]);
+        }
+        reduce_merge(&p, &tasks[k].part);
+    }
+
+    free(tasks);
+    free(tids);
+    free(started);
+
+    return reduce_result(c, col->type, &p, col->len);
+}/* type_column_reduce_mt */
+
+int type_count_n(const TypeValue *v, int n, const TypeValue lo,
+                 const TypeValue hi)
+{
+    PROFILE(TYPE_PROF_COUNT_N, lo.type);
+
+    assert(n >= 0);
+    assert(n == 0 || v != NULL);
+    assert(validate_value(type_table(), lo));
+    assert(validate_value(type_table(), hi));
+    assert(lo.type == hi.type);
+
+    int count = 0;
+
+    for (int i=0; i < n; i++){
+        count += (v[i].type == lo.type) &
+                 (v[i].value >= lo.value) & (v[i].value <= hi.value);
+    }
+
+    return count;
+}/* type_count_n */
+
+int type_column_count(const TypeColumn *col, const TypeValue lo,
+                      const TypeValue hi)
+{
+    PROFILE(TYPE_PROF_COLUMN_COUNT, col->type);
+
+    assert(col != NULL);
+    assert(validate_value(type_table(), lo));
+    assert(validate_value(type_table(), hi));
+    assert(lo.type == col->type && hi.type == col->type);
+
+    return col->len - simd_kernels()->range(col->values, col->len,
+                                            lo.value, hi.value, NULL);
+}/* type_column_count */
+
+/* Rings.
+ * The positions grow forever (64 bits), the slot is position & mask.
+ * SPSC: every side reads the position of the other one only when the
+ * cached copy is not enough for the batch.
+ * MPSC: the producers claim the slots with a CAS on the head and mark
+ * every slot as ready (position + 1) after the copy, the consumer stops at
+ * the first slot not ready.
+ */
+
+#define RING_LINE   TYPE_COLUMN_ALIGN   /* a cache line */
+#define RING_CHUNK  256                 /* values popped at once in a column */
+
+/* position of a side, with the last seen position of the other side */
+union RingSide {
+    struct {
+        unsigned long long pos;
+        unsigned long long seen;
+    } s;
+    char line[RING_LINE];
+};
+
+struct TypeRing {
+    union {
+        struct {
+            enum TypeRingMode mode;
+            unsigned long long capacity;
+            size_t elem;                /* sizeof(TypeValue) or sizeof(type_packed) */
+            char *slots;
+            unsigned long long *ready;  /* MPSC only */
+        } c;
+        char line[RING_LINE];
+    } conf;
+    union RingSide prod;
+    union RingSide cons;
+};
+
+static
+size_t ring_size(int capacity, size_t elem)
+{
+    assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+
+    return RING_LINE - 1 + sizeof(struct TypeRing) +
+           column_round((size_t)capacity * elem) +
+           (size_t)capacity * sizeof(unsigned long long);
+}/* ring_size */
+
+static
+TypeRing *ring_init(void *mem, int capacity, enum TypeRingMode mode,
+                    size_t elem)
+{
+    assert(mem != NULL);
+    assert(mode == TYPE_RING_SPSC || mode == TYPE_RING_MPSC);
+
+    memset(mem, 0, ring_size(capacity, elem));
+
+    uintptr_t start = (uintptr_t)mem;
+    start = (start + RING_LINE - 1) & ~((uintptr_t)RING_LINE - 1);
+
+    TypeRing *r = (TypeRing *)start;
+    r->conf.c.mode = mode;
+    r->conf.c.capacity = (unsigned long long)capacity;
+    r->conf.c.elem = elem;
+    r->conf.c.slots = (char *)(r + 1);
+    r->conf.c.ready = (unsigned long long *)(r->conf.c.slots +
+                      column_round((size_t)capacity * elem));
+    return r;
+}/* ring_init */
+
+/* copy k values from v to the slots from pos, wrapping at the end.
+ * The elem is a constant of the caller, so the copies are inlined.
+ */
+static inline
+void ring_copy_in(TypeRing *r, unsigned long long pos, const void *v, int k,
+                  size_t elem)
+{
+    if (k == 0){
+        return;
+    }
+
+    const unsigned long long i = pos & (r->conf.c.capacity - 1);
+    const size_t first = (size_t)((r->conf.c.capacity - i < (unsigned)k) ?
+                                  r->conf.c.capacity - i : (unsigned)k);
+
+    memcpy(r->conf.c.slots + i * elem, v, first * elem);
+    memcpy(r->conf.c.slots, (const char *)v + first * elem,
+           ((size_t)k - first) * elem);
+}/* ring_copy_in */
+
+static inline
+void ring_copy_out(const TypeRing *r, unsigned long long pos, void *v, int k,
+                   size_t elem)
+{
+    if (k == 0){
+        return;
+    }
+
+    const unsigned long long i = pos & (r->conf.c.capacity - 1);
+    const size_t first = (size_t)((r->conf.c.capacity - i < (unsigned)k) ?
+                                  r->conf.c.capacity - i : (unsigned)k);
+
+    memcpy(v, r->conf.c.slots + i * elem, first * elem);
+    memcpy((char *)v + first * elem, r->conf.c.slots,
+           ((size_t)k - first) * elem);
+}/* ring_copy_out */
+
+static inline
+int ring_push_spsc(TypeRing *r, const void *v, int n, size_t elem)
+{
+    const unsigned long long cap = r->conf.c.capacity;
+    const unsigned long long head = r->prod.s.pos;
+    unsigned long long tail = r->prod.s.seen;
+
+    if (cap - (head - tail) < (unsigned)n){
+        tail = __atomic_load_n(&r->cons.s.pos, __ATOMIC_ACQUIRE);
+        r->prod.s.seen = tail;
+    }
+
+    const unsigned long long space = cap - (head - tail);
+    const int k = (space < (unsigned)n) ? (int)space : n;
+
+    ring_copy_in(r, head, v, k, elem);
+    __atomic_store_n(&r->prod.s.pos, head + k, __ATOMIC_RELEASE);
+
+    return k;
+}/* ring_push_spsc */
+
+static inline
+int ring_push_mpsc(TypeRing *r, const void *v, int n, size_t elem)
+{
+    const unsigned long long cap = r->conf.c.capacity;
+    unsigned long long head = __atomic_load_n(&r->prod.s.pos, __ATOMIC_RELAXED);
+    int k;
+
+    /* head can be stale, behind the pushes of the other producers and
+     * even behind tail: then head - tail can wrap and space is too large,
+     * never too small, but the CAS fails and reloads head. The CAS
+     * succeeds only with the current head, that is not behind tail, so the
+     * claimed space is exact.
+     */
+    do {
+        unsigned long long tail = __atomic_load_n(&r->cons.s.pos,
+                                                  __ATOMIC_ACQUIRE);
+        unsigned long long space = cap - (head - tail);
+
+        k = (space < (unsigned)n) ? (int)space : n;
+        if (k == 0){
+            return 0;
+        }
+    } while (!__atomic_compare_exchange_n(&r->prod.s.pos, &head, head + k,
+                                          true, __ATOMIC_RELAXED,
+                                          __ATOMIC_RELAXED));
+
+    ring_copy_in(r, head, v, k, elem);
+    for (int i=0; i < k; i++){
+        __atomic_store_n(&r->conf.c.ready[(head + i) & (cap - 1)],
+                         head + i + 1, __ATOMIC_RELEASE);
+    }
+
+    return k;
+}/* ring_push_mpsc */
+
+static inline
+int ring_push(TypeRing *r, const void *v, int n, size_t elem)
+{
+    assert(n >= 0);
+    assert(n == 0 || v != NULL);
+
+    if (r->conf.c.mode == TYPE_RING_SPSC){
+        return ring_push_spsc(r, v, n, elem);
+    }
+    return ring_push_mpsc(r, v, n, elem);
+}/* ring_push */
+
+static inline
+int ring_pop(TypeRing *r, void *v, int n, size_t elem)
+{
+    assert(n >= 0);
+    assert(n == 0 || v != NULL);
+
+    const unsigned long long tail = r->cons.s.pos;
+    int k = 0;
+
+    if (r->conf.c.mode == TYPE_RING_SPSC){
+        unsigned long long head = r->cons.s.seen;
+
+        if (head - tail < (unsigned)n){
+            head = __atomic_load_n(&r->prod.s.pos, __ATOMIC_ACQUIRE);
+            r->cons.s.seen = head;
+        }
+        k = (head - tail < (unsigned)n) ? (int)(head - tail) : n;
+    } else {
+        const unsigned long long mask = r->conf.c.capacity - 1;
+
+        while (k < n &&
+               __atomic_load_n(&r->conf.c.ready[(tail + k) & mask],
+                               __ATOMIC_ACQUIRE) == tail + k + 1){
+            k++;
+        }
+    }
+
+    ring_copy_out(r, tail, v, k, elem);
+    __atomic_store_n(&r->cons.s.pos, tail + k, __ATOMIC_RELEASE);
+
+    return k;
+}/* ring_pop */
+
+size_t type_ring_size(int capacity)
+{
+    return ring_size(capacity, sizeof(TypeValue));
+}/* type_ring_size */
+
+size_t type_ring_packed_size(int capacity)
+{
+    return ring_size(capacity, sizeof(type_packed));
+}/* type_ring_packed_size */
+
+TypeRing *type_ring(void *mem, int capacity, enum TypeRingMode mode)
+{
+    return ring_init(mem, capacity, mode, sizeof(TypeValue));
+}/* type_ring */
+
+TypeRing *type_ring_packed(void *mem, int capacity, enum TypeRingMode mode)
+{
+    return ring_init(mem, capacity, mode, sizeof(type_packed));
+}/* type_ring_packed */
+
+int type_ring_push_n(TypeRing *r, const TypeValue *v, int n)
+{
+    assert(r != NULL && r->conf.c.elem == sizeof(TypeValue));
+    PROFILE(TYPE_PROF_RING_PUSH_N, (n > 0) ? v[0].type : -1);
+
+    return ring_push(r, v, n, sizeof(TypeValue));
+}/* type_ring_push_n */
+
+int type_ring_pop_n(TypeRing *r, TypeValue *out, int n)
+{
+    assert(r != NULL && r->conf.c.elem == sizeof(TypeValue));
+    PROFILE(TYPE_PROF_RING_POP_N, -1);
+
+    return ring_pop(r, out, n, sizeof(TypeValue));
+}/* type_ring_pop_n */
+
+int type_ring_push_packed_n(TypeRing *r, const type_packed *p, int n)
+{
+    assert(r != NULL && r->conf.c.elem == sizeof(type_packed));
+    PROFILE(TYPE_PROF_RING_PUSH_PACKED_N, (n > 0) ? pack_type(p[0]) : -1);
+
+    return ring_push(r, p, n, sizeof(type_packed));
+}/* type_ring_push_packed_n */
+
+int type_ring_pop_packed_n(TypeRing *r, type_packed *out, int n)
+{
+    assert(r != NULL && r->conf.c.elem == sizeof(type_packed));
+    PROFILE(TYPE_PROF_RING_POP_PACKED_N, -1);
+
+    return ring_pop(r, out, n, sizeof(type_packed));
+}/* type_ring_pop_packed_n */
+
+int type_ring_pop_column(TypeRing *r, TypeColumn *col,
+                         enum TypeStatus *status)
+{
+    assert(r != NULL && r->conf.c.elem == sizeof(TypeValue));
+    assert(col != NULL);
+    PROFILE(TYPE_PROF_RING_POP_COLUMN, col->type);
+
+    TypeValue buf[RING_CHUNK];
+    int total = 0;
+
+    while (total < col->len){
+        const int want = (col->len - total < RING_CHUNK) ? col->len - total
+                                                         : RING_CHUNK;
+        const int k = ring_pop(r, buf, want, sizeof(TypeValue));
+
+        for (int i=0; i < k; i++){
+            enum TypeStatus st = type_column_put(col, total + i, buf[i]);
+            if (status != NULL){
+                status[total + i] = st;
+            }
+        }
+
+        total += k;
+        if (k < want){
+            break;
+        }
+    }
+
+    return total;
+}/* type_ring_pop_column */
+
+int type_ring_count(const TypeRing *r)
+{
+    assert(r != NULL);
+
+    /* the tail first, it never passes the head */
+    unsigned long long tail = __atomic_load_n(&r->cons.s.pos, __ATOMIC_ACQUIRE);
+    unsigned long long head = __atomic_load_n(&r->prod.s.pos, __ATOMIC_ACQUIRE);
+
+    return (int)(head - tail);
+}/* type_ring_count */
+
+/* Narrow columns.
+ * The lanes are int8_t, int16_t, int32_t or type_value_store. The
+ * operations load the lanes widened, so the checks are the same of the
+ * other columns, and store back only the results in the range of the type
+ * (every kernel checks it), that fit the lane by construction.
+ */
+
+int type_width(int type)
+{
+    const struct TypeTable *tt = type_table();
+
+    assert(validate_type(tt, type));
+
+    const struct TypeDesc *c = &tt->desc[type];
+
+    if (c->rangeMin >= INT8_MIN && c->rangeMax <= INT8_MAX){
+        return 1;
+    }
+    if (c->rangeMin >= INT16_MIN && c->rangeMax <= INT16_MAX){
+        return 2;
+    }
+    if (c->rangeMin >= INT32_MIN && c->rangeMax <= INT32_MAX){
+        return 4;
+    }
+    return sizeof(type_value_store);
+}/* type_width */
+
+/* With a constant width, once inlined the switch disappears */
+static inline
+type_value_store lane_load(const void *lanes, int width, int i)
+{
+    switch (width){
+    case 1:
+        return ((const int8_t *)lanes)[i];
+    case 2:
+        return ((const int16_t *)lanes)[i];
+    case 4:
+        return ((const int32_t *)lanes)[i];
+    default:
+        return ((const type_value_store *)lanes)[i];
+    }/* switch */
+}/* lane_load */
+
+static inline
+void lane_store(void *lanes, int width, int i, type_value_store v)
+{
+    switch (width){
+    case 1:
+        ((int8_t *)lanes)[i] = (int8_t)v;
+        break;
+    case 2:
+        ((int16_t *)lanes)[i] = (int16_t)v;
+        break;
+    case 4:
+        ((int32_t *)lanes)[i] = (int32_t)v;
+        break;
+    default:
+        ((type_value_store *)lanes)[i] = v;
+        break;
+    }/* switch */
+}/* lane_store */
+
+size_t type_narrow_size(int type, int len)
+{
+    assert(len >= 0);
+
+    size_t size = TYPE_COLUMN_ALIGN; /* room for aligning the memory start */
+    size += column_round((size_t)len * type_width(type));
+#ifdef TYPE_TIMESTAMP
+    size += column_round((size_t)len * sizeof(type_millisecs));
+#endif
+    return size;
+}/* type_narrow_size */
+
+TypeNarrow type_narrow(int type, void *mem, int len)
+{
+    assert(mem != NULL);
+    assert(len >= 0);
+
+    const int width = type_width(type);
+
+    memset(mem, 0, type_narrow_size(type, len));
+
+    uintptr_t start = (uintptr_t)mem;
+    start = (start + TYPE_COLUMN_ALIGN - 1) & ~((uintptr_t)TYPE_COLUMN_ALIGN - 1);
+
+    TypeNarrow col = {.type = type, .len = len, .width = width};
+    col.values = (void *)start;
+#ifdef TYPE_TIMESTAMP
+    start += column_round((size_t)len * width);
+    col.timestamps = (type_millisecs *)start;
+#endif
+    return col;
+}/* type_narrow */
+
+TypeValue type_narrow_get(const TypeNarrow *col, int i)
+{
+    assert(col != NULL);
+    assert(i >= 0 && i < col->len);
+
+    TypeValue t = {.type = col->type,
+                   .value = lane_load(col->values, col->width, i)};
+#ifdef TYPE_TIMESTAMP
+    t.timestamp = col->timestamps[i];
+#endif
+    return t;
+}/* type_narrow_get */
+
+enum TypeStatus type_narrow_put(TypeNarrow *col, int i, const TypeValue tv)
+{
+    assert(col != NULL);
+    assert(i >= 0 && i < col->len);
+    assert(validate_value(type_table(), tv));
+
+    if (tv.type != col->type){
+        return TS_INCOMPATIBLE;
+    }
+
+    lane_store(col->values, col->width, i, tv.value);
+#ifdef TYPE_TIMESTAMP
+    col->timestamps[i] = tv.timestamp;
+#endif
+    return TS_OK;
+}/* type_narrow_put */
+
+static
+void narrow_stamp(TypeNarrow *col, const enum TypeStatus *status)
+{
+#ifdef TYPE_TIMESTAMP
+    stamp_array(col->timestamps, col->len, status);
+#else
+    (void)col;
+    (void)status;
+#endif
+}/* narrow_stamp */
+
+int type_narrow_set(TypeNarrow *col, enum TypeStatus *status,
+                    const type_value_store *v)
+{
+    PROFILE(TYPE_PROF_NARROW_SET, col->type);
+
+    const struct TypeTable *tt = type_table();
+
+    assert(col != NULL);
+    assert(validate_type(tt, col->type));
+
+    const struct TypeDesc *c = &tt->desc[col->type];
+    int failed = 0;
+
+    for (int i=0; i < col->len; i++){
+        type_value_store x = desc_cut(c, v[i]); /* enforce precision */
+        bool ok = store_in_range(c, x);
+
+        if (ok){
+            lane_store(col->values, col->width, i, x);
+        }
+        status[i] = ok ? TS_OK : TS_OUTRANGE;
+        failed += !ok;
+    }
+
+    narrow_stamp(col, status);
+    return failed;
+}/* type_narrow_set */
+
+/* The bulk passes, one instance for each width up to 32 bits.
+ * The range of the type fits the lane, so the checks are on 32 bits: twice
+ * the lanes per register than on 64 bits, and no 64 bits comparisons that
+ * are missing before SSE4.2. The lanes of 64 bits use the column kernels.
+ */
+static inline
+int narrow_range_lanes(int width, const void *lanes, int len,
+                       int32_t min, int32_t max, enum TypeStatus *status)
+{
+    int failed = 0;
+
+    for (int i=0; i < len; i++){
+        int32_t x = (int32_t)lane_load(lanes, width, i);
+        bool ok = (x >= min) && (x <= max);
+
+        if (status != NULL){
+            status[i] = ok ? TS_OK : TS_OUTRANGE;
+        }
+        failed += !ok;
+    }
+
+    return failed;
+}/* narrow_range_lanes */
+
+static inline
+int narrow_sum_lanes(int width, void *out, enum TypeStatus *status,
+                     const void *a, const void *b, int len,
+                     int32_t min, int32_t max)
+{
+    int failed = 0;
+
+    for (int i=0; i < len; i++){
+        int32_t xa = (int32_t)lane_load(a, width, i);
+        int32_t xb = (int32_t)lane_load(b, width, i);
+        int32_t x = (int32_t)((uint32_t)xa + (uint32_t)xb);
+
+        /* wrapped only with 32 bits lanes: the sign differs from both */
+        bool ok = ((xa ^ x) & (xb ^ x)) >= 0;
+        ok = ok && (x >= min) && (x <= max);
+
+        lane_store(out, width, i, ok ? x : lane_load(out, width, i));
+        status[i] = ok ? TS_OK : TS_OUTRANGE;
+        failed += !ok;
+    }
+
+    return failed;
+}/* narrow_sum_lanes */
+
+static
+int narrow_range(const TypeNarrow *col, const struct TypeDesc *c,
+                 enum TypeStatus *status)
+{
+    const int32_t min = (int32_t)c->rangeMin;
+    const int32_t max = (int32_t)c->rangeMax;
+
+    switch (col->width){
+    case 1:
+        return narrow_range_lanes(1, col->values, col->len, min, max, status);
+    case 2:
+        return narrow_range_lanes(2, col->values, col->len, min, max, status);
+    case 4:
+        return narrow_range_lanes(4, col->values, col->len, min, max, status);
+    default:
+        return simd_kernels()->range(col->values, col->len,
+                                     c->rangeMin, c->rangeMax, status);
+    }/* switch */
+}/* narrow_range */
+
+static
+int narrow_sum(TypeNarrow *out, enum TypeStatus *status,
+               const TypeNarrow *a, const TypeNarrow *b,
+               const struct TypeDesc *c)
+{
+    const int32_t min = (int32_t)c->rangeMin;
+    const int32_t max = (int32_t)c->rangeMax;
+    const int len = out->len;
+
+    switch (out->width){
+    case 1:
+        return narrow_sum_lanes(1, out->values, status, a->values, b->values,
+                                len, min, max);
+    case 2:
+        return narrow_sum_lanes(2, out->values, status, a->values, b->values,
+                                len, min, max);
+    case 4:
+        return narrow_sum_lanes(4, out->values, status, a->values, b->values,
+                                len, min, max);
+    default:
+        return simd_kernels()->sum(out->values, status, a->values,
+                                   b->values, len, c->rangeMin, c->rangeMax);
+    }/* switch */
+}/* narrow_sum */
+
+/* Apply the kernel on the widened lanes, only the TS_OK are stored */
+static
+int narrow_apply(const struct TypeDesc *c, TypeNarrow *out,
+                 enum TypeStatus *status,
+                 const TypeNarrow *a, const TypeNarrow *b,
+                 store_kernel kernel)
+{
+    const int width = out->width;
+    int failed = 0;
+
+    for (int i=0; i < out->len; i++){
+        type_value_store v = 0;
+        enum TypeStatus st = kernel(c, lane_load(a->values, width, i),
+                                    lane_load(b->values, width, i), &v);
+        if (st == TS_OK){
+            lane_store(out->values, width, i, v);
+        }
+        status[i] = st;
+        failed += (st != TS_OK);
+    }
+
+    return failed;
+}/* narrow_apply */
+
+/* common checks of the narrow operations, as column_desc() */
+static
+const struct TypeDesc *narrow_desc(const TypeNarrow *out,
+                                   const TypeNarrow *a, const TypeNarrow *b)
+{
+    const struct TypeTable *tt = type_table();
+
+    assert(out != NULL && a != NULL && b != NULL);
+    assert(a->len == out->len && b->len == out->len);
+    assert(validate_type(tt, out->type));
+
+    if (a->type != out->type || b->type != out->type){
+        return NULL;
+    }
+
+    return &tt->desc[out->type];
+}/* narrow_desc */
+
+int type_narrow_sum(TypeNarrow *out, enum TypeStatus *status,
+                    const TypeNarrow *a, const TypeNarrow *b)
+{
+    PROFILE(TYPE_PROF_NARROW_SUM, out->type);
+
+    const struct TypeDesc *c = narrow_desc(out, a, b);
+    int failed = 0;
+
+    switch (desc_category(c)){
+    case INTEGER: /* fall through */
+    case DECIMAL:
+        failed = narrow_sum(out, status, a, b, c);
+        narrow_stamp(out, status);
+        STATS_COUNT_N(TYPE_OP_SUM, out->type, out->len, failed, 0);
+        return failed;
+    default:
+        STATS_COUNT_N(TYPE_OP_SUM, out->type, out->len, 0, out->len);
+        return column_fail(status, out->len, TS_INCOMPATIBLE);
+    }/* switch */
+}/* type_narrow_sum */
+
+int type_narrow_mul(TypeNarrow *out, enum TypeStatus *status,
+                    const TypeNarrow *a, const TypeNarrow *b)
+{
+    PROFILE(TYPE_PROF_NARROW_MUL, out->type);
+
+    const struct TypeDesc *c = narrow_desc(out, a, b);
+    int failed = 0;
+
+    switch (desc_category(c)){
+    case INTEGER:
+        failed = narrow_apply(c, out, status, a, b, store_imul);
+        break;
+    case DECIMAL:
+        failed = narrow_apply(c, out, status, a, b, store_dmul);
+        break;
+    default:
+        STATS_COUNT_N(TYPE_OP_MUL, out->type, out->len, 0, out->len);
+        return column_fail(status, out->len, TS_INCOMPATIBLE);
+    }/* switch */
+
+    narrow_stamp(out, status);
+    STATS_COUNT_N(TYPE_OP_MUL, out->type, out->len, failed, 0);
+    return failed;
+}/* type_narrow_mul */
+
+int type_narrow_div(TypeNarrow *out, enum TypeStatus *status,
+                    const TypeNarrow *a, const TypeNarrow *b)
+{
+    PROFILE(TYPE_PROF_NARROW_DIV, out->type);
+
+    const struct TypeDesc *c = narrow_desc(out, a, b);
+    int failed = 0;
+
+    switch (desc_category(c)){
+    case INTEGER:
+        failed = narrow_apply(c, out, status, a, b, store_idiv);
+        break;
+    case DECIMAL:
+        failed = narrow_apply(c, out, status, a, b, store_ddiv_checked);
+        break;
+    default:
+        STATS_COUNT_N(TYPE_OP_DIV, out->type, out->len, 0, out->len);
+        return column_fail(status, out->len, TS_INCOMPATIBLE);
+    }/* switch */
+
+    narrow_stamp(out, status);
+    STATS_COUNT_N(TYPE_OP_DIV, out->type, out->len, failed, 0);
+    return failed;
+}/* type_narrow_div */
+
+int type_narrow_validate(const TypeNarrow *col, enum TypeStatus *status)
+{
+    PROFILE(TYPE_PROF_NARROW_VALIDATE, col->type);
+
+    const struct TypeTable *tt = type_table();
+
+    assert(col != NULL);
+    assert(validate_type(tt, col->type));
+
+    return narrow_range(col, &tt->desc[col->type], status);
+}/* type_narrow_validate */
+
+int type_dec_units(const TypeValue tv)
+{
+    assert(type_table()->desc[tv.type].category == DECIMAL);
+    return tv.value / TYPE_DECIMAL_POWER;
+}/* type_dec_unites */
+
+int type_dec_decimals(const TypeValue tv)
+{
+    const struct TypeTable *tt = type_table();
+
+    assert(tt->desc[tv.type].category == DECIMAL);
+    return desc_div(&tt->desc[tv.type], tv.value % TYPE_DECIMAL_POWER);
+}/* type_dec_decimals */
+
+/* Formatting without printf: the digits are written from the right, two
+ * at a time from the table of the pairs "00".."99".
+ */
+static const char DIGIT_PAIRS[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+/* write u before end, return the first char */
+static inline
+char *str_uint(char *end, unsigned long long u)
+{
+    while (u >= 100){
+        unsigned r = (unsigned)(u % 100);
+        u /= 100;
+        end -= 2;
+        memcpy(end, &DIGIT_PAIRS[r * 2], 2);
+    }
+
+    if (u >= 10){
+        end -= 2;
+        memcpy(end, &DIGIT_PAIRS[u * 2], 2);
+    } else {
+        *--end = (char)('0' + u);
+    }
+
+    return end;
+}/* str_uint */
+
+/* write exactly width digits of u (zero padded) before end */
+static inline
+char *str_digits(char *end, unsigned long long u, int width)
+{
+    for (; width >= 2; width -= 2){
+        unsigned r = (unsigned)(u % 100);
+        u /= 100;
+        end -= 2;
+        memcpy(end, &DIGIT_PAIRS[r * 2], 2);
+    }
+
+    if (width == 1){
+        *--end = (char)('0' + u % 10);
+    }
+
+    return end;
+}/* str_digits */
+
+/* Format the value in buf (at least TYPE_STR_LEN) with the terminator.
+ * The DECIMAL values are units, dot and the precision digits, with the sign
+ * in front also when the units are zero.
+ * Return the length, without the terminator.
+ */
+static
+int str_value(char *buf, const TypeValue tv)
+{
+    const struct TypeTable *tt = type_table();
+
+    const struct TypeDesc *c = &tt->desc[tv.type];
+    char tmp[TYPE_STR_LEN];
+    char *end = tmp + sizeof(tmp);
+    char *start = end;
+    bool neg = tv.value < 0;
+    unsigned long long u = neg ? 0ULL - (unsigned long long)tv.value
+                               : (unsigned long long)tv.value;
+
+    switch (c->category){
+    case NOMINAL: /* fall through */
+    case INTEGER:
+        start = str_uint(end, u);
+        break;
+    case DECIMAL:
+        start = str_digits(end, desc_div(c, u % TYPE_DECIMAL_POWER),
+                           c->precision);
+        *--start = '.';
+        start = str_uint(start, u / TYPE_DECIMAL_POWER);
+        break;
+    default:
+        errx(EXIT_FAILURE, "Invalid category configuration for type: %i", tv.type);
+        break;
+    }/* switch */
+
+    if (neg){
+        *--start = '-';
+    }
+
+    int len = (int)(end - start);
+    memcpy(buf, start, len);
+    buf[len] = '\0';
+
+    return len;
+}/* str_value */
+
+void type_str(char *buf, const TypeValue tv)
+{
+    PROFILE(TYPE_PROF_STR, tv.type);
+
+    str_value(buf, tv);
+    STATS_COUNT(TYPE_OP_STR, tv.type, TS_OK);
+}/* type_str */
+
+int type_str_n(char *buf, int size, const TypeValue *tv, int n, char sep)
+{
+    PROFILE(TYPE_PROF_STR_N, (n > 0) ? tv[0].type : -1);
+
+    assert(buf != NULL);
+    assert(size > 0);
+    assert(n >= 0);
+
+    char tmp[TYPE_STR_LEN];
+    int pos = 0;
+
+    buf[0] = '\0';
+
+    for (int i=0; i < n; i++){
+        int len = str_value(tmp, tv[i]);
+        int need = len + (i > 0); /* separator */
+
+        if (pos + need >= size){ /* room for the terminator */
+            buf[pos] = '\0';
+            STATS_COUNT_N(TYPE_OP_STR, tv[0].type, i, 0, 0);
+            return -1;
+        }
+
+        if (i > 0){
+            buf[pos++] = sep;
+        }
+        memcpy(buf + pos, tmp, len);
+        pos += len;
+    }
+
+    buf[pos] = '\0';
+    STATS_COUNT_N(TYPE_OP_STR, (n > 0) ? tv[0].type : -1, n, 0, 0);
+    return pos;
+}/* type_str_n */
+
+#ifdef TYPE_TIMESTAMP
+type_millisecs type_get_time(const TypeValue tv)
+{
+    return tv.timestamp;
+}/* type_get_time */
+
+void type_time_begin(void)
+{
+    type_time_begin_at(type_now());
+}/* type_time_begin */
+
+void type_time_begin_at(type_millisecs now)
+{
+    assert(!scopeOpen); /* no nesting */
+    scopeTime = now;
+    scopeOpen = true;
+}/* type_time_begin_at */
+
+void type_time_end(void)
+{
+    assert(scopeOpen);
+    scopeOpen = false;
+}/* type_time_end */
+
+/* Staleness index.
+ * The channels are in a list ordered by timestamp, the oldest first.
+ * With the timestamps of type_now() (monotonic) an update moves the
+ * channel at the end in O(1), an older timestamp walks back from the end.
+ * The queries read from the head only the stale channels.
+ */
+
+struct StaleNode {
+    type_millisecs time;
+    int prev;   /* -1 at the head */
+    int next;   /* -1 at the tail */
+};
+
+struct TypeStale {
+    int channels;
+    int head;
+    int tail;
+    struct StaleNode *nodes;
+};
+
+static
+void stale_unlink(TypeStale *s, int ch)
+{
+    struct StaleNode *nd = &s->nodes[ch];
+
+    if (nd->prev >= 0){
+        s->nodes[nd->prev].next = nd->next;
+    } else {
+        s->head = nd->next;
+    }
+
+    if (nd->next >= 0){
+        s->nodes[nd->next].prev = nd->prev;
+    } else {
+        s->tail = nd->prev;
+    }
+}/* stale_unlink */
+
+/* after the last channel with a time not greater */
+static
+void stale_insert(TypeStale *s, int ch)
+{
+    struct StaleNode *nd = &s->nodes[ch];
+    int p = s->tail;
+
+    while (p >= 0 && s->nodes[p].time > nd->time){
+        p = s->nodes[p].prev;
+    }
+
+    nd->prev = p;
+    nd->next = (p >= 0) ? s->nodes[p].next : s->head;
+
+    if (nd->next >= 0){
+        s->nodes[nd->next].prev = ch;
+    } else {
+        s->tail = ch;
+    }
+
+    if (p >= 0){
+        s->nodes[p].next = ch;
+    } else {
+        s->head = ch;
+    }
+}/* stale_insert */
+
+size_t type_stale_size(int channels)
+{
+    assert(channels >= 0);
+
+    return TYPE_COLUMN_ALIGN - 1 + sizeof(struct TypeStale) +
+           (size_t)channels * sizeof(struct StaleNode);
+}/* type_stale_size */
+
+TypeStale *type_stale(void *mem, int channels)
+{
+    assert(mem != NULL);
+
+    memset(mem, 0, type_stale_size(channels));
+
+    uintptr_t start = (uintptr_t)mem;
+    start = (start + TYPE_COLUMN_ALIGN - 1) & ~((uintptr_t)TYPE_COLUMN_ALIGN - 1);
+
+    TypeStale *s = (TypeStale *)start;
+    s->channels = channels;
+    s->head = (channels > 0) ? 0 : -1;
+    s->tail = channels - 1;
+    s->nodes = (struct StaleNode *)(s + 1);
+
+    for (int i=0; i < channels; i++){
+        s->nodes[i].prev = i - 1;
+        s->nodes[i].next = (i + 1 < channels) ? i + 1 : -1;
+    }
+
+    return s;
+}/* type_stale */
+
+static
+void stale_touch(TypeStale *s, int ch, type_millisecs time)
+{
+    assert(s != NULL);
+    assert(ch >= 0 && ch < s->channels);
+
+    struct StaleNode *nd = &s->nodes[ch];
+
+    /* already in order, e.g. the same channel again */
+    if (nd->next < 0 && (nd->prev < 0 || s->nodes[nd->prev].time <= time)){
+        nd->time = time;
+        return;
+    }
+
+    stale_unlink(s, ch);
+    nd->time = time;
+    stale_insert(s, ch);
+}/* stale_touch */
+
+void type_stale_touch(TypeStale *s, int ch, type_millisecs time)
+{
+    PROFILE(TYPE_PROF_STALE_TOUCH, -1);
+
+    stale_touch(s, ch, time);
+}/* type_stale_touch */
+
+void type_stale_put(TypeStale *s, int ch, const TypeValue tv)
+{
+    PROFILE(TYPE_PROF_STALE_PUT, tv.type);
+
+    stale_touch(s, ch, tv.timestamp);
+}/* type_stale_put */
+
+int type_stale_put_n(TypeStale *s, const int *ch, const TypeValue *tv,
+                     const enum TypeStatus *status, int n)
+{
+    assert(n >= 0);
+    assert(n == 0 || (ch != NULL && tv != NULL));
+    PROFILE(TYPE_PROF_STALE_PUT_N, (n > 0) ? tv[0].type : -1);
+
+    int failed = 0;
+
+    for (int i=0; i < n; i++){
+        if (status != NULL && status[i] != TS_OK){
+            failed++;
+            continue;
+        }
+        stale_touch(s, ch[i], tv[i].timestamp);
+    }
+
+    return failed;
+}/* type_stale_put_n */
+
+type_millisecs type_stale_time(const TypeStale *s, int ch)
+{
+    assert(s != NULL);
+    assert(ch >= 0 && ch < s->channels);
+
+    return s->nodes[ch].time;
+}/* type_stale_time */
+
+int type_stale_query(const TypeStale *s, type_millisecs deadline, int *out,
+                     int max)
+{
+    assert(s != NULL);
+    assert(max >= 0);
+    assert(max == 0 || out != NULL);
+    PROFILE(TYPE_PROF_STALE_QUERY, -1);
+
+    int k = 0;
+
+    for (int c = s->head; c >= 0 && k < max && s->nodes[c].time < deadline;
+         c = s->nodes[c].next){
+        out[k++] = c;
+    }
+
+    return k;
+}/* type_stale_query */
+#endif
+
+#ifdef TYPE_STATS
+void type_stats(struct TypeStats *out)
+{
+    assert(out != NULL);
+
+    pthread_mutex_lock(&blocksLock);
+    *out = statsEnded;
+    for (struct ThreadBlock *b = threadBlocks; b != NULL; b = b->next){
+        type_stats_merge(out, &b->stats);
+    }
+    pthread_mutex_unlock(&blocksLock);
+}/* type_stats */
+
+void type_stats_thread(struct TypeStats *out)
+{
+    assert(out != NULL);
+
+    if (threadBlock == NULL){
+        memset(out, 0, sizeof(struct TypeStats));
+        return;
+    }
+
+    *out = threadBlock->stats;
+}/* type_stats_thread */
+
+/* in can be the counters of a running thread */
+void type_stats_merge(struct TypeStats *out, const struct TypeStats *in)
+{
+    assert(out != NULL && in != NULL);
+
+    for (int t=0; t < TYPE_STATS_TYPES; t++){
+        for (int op=0; op < TYPE_OP_ALL; op++){
+            const struct TypeStat *x = &in->stat[t][op];
+            struct TypeStat *y = &out->stat[t][op];
+
+            y->ops += stat_load(&x->ops);
+            y->outrange += stat_load(&x->outrange);
+            y->incompatible += stat_load(&x->incompatible);
+        }
+    }
+}/* type_stats_merge */
+#endif
+
+#ifdef TYPE_PROFILE
+void type_profile(struct TypeProfile *out)
+{
+    assert(out != NULL);
+
+    pthread_once(&blocksOnce, block_key_init); /* profileEnded */
+
+    pthread_mutex_lock(&blocksLock);
+    *out = profileEnded;
+    for (struct ThreadBlock *b = threadBlocks; b != NULL; b = b->next){
+        type_profile_merge(out, &b->profile);
+    }
+    pthread_mutex_unlock(&blocksLock);
+}/* type_profile */
+
+void type_profile_thread(struct TypeProfile *out)
+{
+    assert(out != NULL);
+
+    if (threadBlock == NULL){
+        profile_init(out);
+        return;
+    }
+
+    *out = threadBlock->profile;
+}/* type_profile_thread */
+
+/* in can be the histograms of a running thread */
+void type_profile_merge(struct TypeProfile *out, const struct TypeProfile *in)
+{
+    assert(out != NULL && in != NULL);
+    assert(out->asserts == in->asserts && out->ns == in->ns);
+
+    for (int op=0; op < TYPE_PROF_ALL; op++){
+        for (int c=0; c < TYPE_PROF_CATEGORIES; c++){
+            const struct TypeProfHist *x = &in->hist[op][c];
+            struct TypeProfHist *y = &out->hist[op][c];
+
+            y->count += stat_load(&x->count);
+            y->total += stat_load(&x->total);
+            for (int i=0; i < TYPE_PROF_BUCKETS; i++){
+                y->bucket[i] += stat_load(&x->bucket[i]);
+            }
+        }
+    }
+}/* type_profile_merge */
+
+/* the upper bound of the bucket with the sample of rank q * count */
+static
+unsigned long long prof_percentile(const struct TypeProfHist *h, double q)
+{
+    unsigned long long rank = (unsigned long long)(q * (double)h->count);
+    unsigned long long seen = 0;
+    int i = 0;
+
+    rank = (rank < 1) ? 1 : rank;
+    for (; i < TYPE_PROF_BUCKETS - 1; i++){
+        seen += h->bucket[i];
+        if (seen >= rank){
+            break;
+        }
+    }
+
+    /* the last bucket has no upper bound */
+    return (i < TYPE_PROF_BUCKETS - 1) ? prof_lower(i + 1) - 1 : prof_lower(i);
+}/* prof_percentile */
+
+void type_profile_dump(FILE *out, const struct TypeProfile *p)
+{
+    assert(out != NULL && p != NULL);
+
+    fprintf(out, "op,category,asserts,unit,count,mean,p50,p90,p99,max\n");
+
+    for (int op=0; op < TYPE_PROF_ALL; op++){
+        for (int c=0; c < TYPE_PROF_CATEGORIES; c++){
+            const struct TypeProfHist *h = &p->hist[op][c];
+
+            if (h->count == 0){
+                continue;
+            }
+
+            fprintf(out, "%s,%s,%i,%s,%llu,%.1f,%llu,%llu,%llu,%llu\n",
+                    PROF_NAME[op], PROF_CATEGORY[c], p->asserts,
+                    p->ns ? "ns" : "tsc", h->count,
+                    (double)h->total / (double)h->count,
+                    prof_percentile(h, 0.5), prof_percentile(h, 0.9),
+                    prof_percentile(h, 0.99), prof_percentile(h, 1.0));
+        }
+    }
+}/* type_profile_dump */
 #endif
@@ -5,6 +5,9 @@
  * A module for enforcing range and type control on numeric data.
  *
  * Define (as compilation flag) TYPE_TIMESTAMP to enable the value time mark.
+ * Define TYPE_STATS to count the operations of every type, see type_stats().
+ * Define TYPE_PROFILE to measure the latency of the operations, see
+ * type_profile().
  * Provide a suitable implementation for
  *
  * type_millisecs type_now(void);
@@ -14,9 +17,26 @@
  * Author: Omar Rampado <omar@ognibit.it>
  */
 
+#include <stddef.h>
+
 #define TYPE_STR_LEN    24
 
+/* alignment in bytes of the column arrays */
+#define TYPE_COLUMN_ALIGN   64
+
 typedef long long type_value_store;
+
+/* Bits of the type index in a packed value, the others hold the value */
+#ifndef TYPE_PACK_TYPE_BITS
+#define TYPE_PACK_TYPE_BITS 8
+#endif
+
+#if TYPE_PACK_TYPE_BITS < 1 || TYPE_PACK_TYPE_BITS > 32
+#error "TYPE_PACK_TYPE_BITS must be in 1..32"
+#endif
+
+/* Type and value in a single word, without the timestamp */
+typedef unsigned long long type_packed;
 #ifdef TYPE_TIMESTAMP
 typedef unsigned long type_millisecs;
 #endif
@@ -42,6 +62,154 @@ enum TypeStatus {
     TS_INCOMPATIBLE
 };
 
+/* Operations counted with TYPE_STATS.
+ * The batch, column and narrow forms count with the single value one: a
+ * call adds its n operations and failures at once, on the type of its
+ * first element. The parsers, the column and narrow setters, the checks,
+ * the reductions, the packed values and the rings are not counted.
+ */
+enum TypeStatOp {
+    TYPE_OP_SETI,
+    TYPE_OP_SETD,   /* type_setd, type_setds and type_setdec */
+    TYPE_OP_SUM,
+    TYPE_OP_MUL,
+    TYPE_OP_DIV,
+    TYPE_OP_STR,
+    TYPE_OP_SUM_SAT,
+    TYPE_OP_MUL_SAT,
+    TYPE_OP_FUSED,  /* type_fma, type_lerp and type_clamp_add */
+    TYPE_OP_CONVERT,
+    TYPE_OP_ALL     /* placeholder */
+};
+
+#ifdef TYPE_STATS
+/* types with counters, the others are not counted */
+#ifndef TYPE_STATS_TYPES
+#define TYPE_STATS_TYPES 64
+#endif
+
+/* Counters of an operation on a type */
+struct TypeStat {
+    unsigned long long ops;
+    unsigned long long outrange;
+    unsigned long long incompatible;
+};
+
+/* Counters of all the types, indexed by type and enum TypeStatOp */
+struct TypeStats {
+    struct TypeStat stat[TYPE_STATS_TYPES][TYPE_OP_ALL];
+};
+#endif
+
+#ifdef TYPE_PROFILE
+#include <stdio.h>
+
+/* every thread measures one call every TYPE_PROFILE_PERIOD */
+#ifndef TYPE_PROFILE_PERIOD
+#define TYPE_PROFILE_PERIOD 1
+#endif
+
+#if TYPE_PROFILE_PERIOD < 1
+#error "TYPE_PROFILE_PERIOD must be at least 1"
+#endif
+
+/* Operations measured with TYPE_PROFILE.
+ * The accessors of a field, the configuration, the time scopes, the sizes
+ * and constructors, the count of a ring and the channel time of a staleness
+ * index are not measured: the timer would cost more than them.
+ */
+enum TypeProfOp {
+    TYPE_PROF_SETI,
+    TYPE_PROF_SETD,
+    TYPE_PROF_SETDS,
+    TYPE_PROF_SETDEC,
+    TYPE_PROF_SETN,
+    TYPE_PROF_PARSE,
+    TYPE_PROF_PARSE_N,
+    TYPE_PROF_FLOAT,
+    TYPE_PROF_STR,
+    TYPE_PROF_STR_N,
+    TYPE_PROF_SUM,
+    TYPE_PROF_MUL,
+    TYPE_PROF_DIV,
+    TYPE_PROF_SUM_SAT,
+    TYPE_PROF_MUL_SAT,
+    TYPE_PROF_FMA,
+    TYPE_PROF_LERP,
+    TYPE_PROF_CLAMP_ADD,
+    TYPE_PROF_CONVERT,
+    TYPE_PROF_ACC,
+    TYPE_PROF_ACC_N,
+    TYPE_PROF_SUM_N,
+    TYPE_PROF_MUL_N,
+    TYPE_PROF_DIV_N,
+    TYPE_PROF_SUM_SAT_N,
+    TYPE_PROF_MUL_SAT_N,
+    TYPE_PROF_FMA_N,
+    TYPE_PROF_CONVERT_N,
+    TYPE_PROF_PACK,
+    TYPE_PROF_UNPACK,
+    TYPE_PROF_PACK_N,
+    TYPE_PROF_UNPACK_N,
+    TYPE_PROF_PACK_SUM,
+    TYPE_PROF_PACK_MUL,
+    TYPE_PROF_PACK_DIV,
+    TYPE_PROF_COLUMN_SET,
+    TYPE_PROF_COLUMN_PARSE,
+    TYPE_PROF_COLUMN_SUM,
+    TYPE_PROF_COLUMN_MUL,
+    TYPE_PROF_COLUMN_DIV,
+    TYPE_PROF_COLUMN_SUM_SAT,
+    TYPE_PROF_COLUMN_CONVERT,
+    TYPE_PROF_COLUMN_VALIDATE,
+    TYPE_PROF_COLUMN_CLAMP,
+    TYPE_PROF_NARROW_SET,
+    TYPE_PROF_NARROW_SUM,
+    TYPE_PROF_NARROW_MUL,
+    TYPE_PROF_NARROW_DIV,
+    TYPE_PROF_NARROW_VALIDATE,
+    TYPE_PROF_REDUCE_N,
+    TYPE_PROF_COLUMN_REDUCE,
+    TYPE_PROF_COLUMN_REDUCE_MT,
+    TYPE_PROF_COUNT_N,
+    TYPE_PROF_COLUMN_COUNT,
+    TYPE_PROF_RING_PUSH_N,
+    TYPE_PROF_RING_POP_N,
+    TYPE_PROF_RING_PUSH_PACKED_N,
+    TYPE_PROF_RING_POP_PACKED_N,
+    TYPE_PROF_RING_POP_COLUMN,
+    TYPE_PROF_STALE_TOUCH,
+    TYPE_PROF_STALE_PUT,
+    TYPE_PROF_STALE_PUT_N,
+    TYPE_PROF_STALE_QUERY,
+    TYPE_PROF_ALL   /* placeholder */
+};
+
+/* the categories, plus one for an invalid type or an empty batch */
+#define TYPE_PROF_CATEGORIES    4
+
+/* Log-linear buckets: 4 for every power of two (25% of resolution), the
+ * last one collects all the samples from 2^32 ticks on.
+ */
+#define TYPE_PROF_BUCKETS       128
+
+/* Latency histogram of an operation on a category */
+struct TypeProfHist {
+    unsigned long long count;
+    unsigned long long total;   /* sum of the samples */
+    unsigned long long bucket[TYPE_PROF_BUCKETS];
+};
+
+/* Latencies of all the operations, indexed by enum TypeProfOp and
+ * enum TypeCategory (TYPE_PROF_CATEGORIES - 1 for the others)
+ */
+struct TypeProfile {
+    int asserts;    /* 1 if the library has the assertions */
+    int ns;         /* 1 if the unit is the ns, 0 for the TSC ticks */
+    struct TypeProfHist hist[TYPE_PROF_ALL][TYPE_PROF_CATEGORIES];
+};
+#endif
+
 /* Configuration for a type */
 struct TypeConf {
     enum TypeCategory category;
@@ -50,14 +218,99 @@ struct TypeConf {
     int precision; /* 0-6 */
 };
 
+/* Operation result on packed values */
+struct TypePackedResult {
+    enum TypeStatus status;
+    type_packed out;
+};
+
+/* Result of a reduction, see type_reduce_n() */
+struct TypeReduction {
+    enum TypeStatus status;     /* of the total */
+    int count;                  /* number of values */
+    struct TypeValue total;
+    struct TypeValue min;
+    struct TypeValue max;
+    struct TypeValue mean;
+};
+
+/* Sticky status of a chain of operations, see type_acc() */
+struct TypeAcc {
+    unsigned flags;             /* bit (1 << status) of every failure */
+    enum TypeStatus first;      /* status of the first failure, TS_OK if none */
+    int failed;                 /* index of the first failure, -1 if none */
+    int count;                  /* operations accumulated */
+};
+
+/* Conversion from a type to another, built once by type_scale().
+ * On the internal stores: out = trunc(v * mul / div) * cut, exact, the
+ * inputs out of [inMin, inMax] give a result out of the range of the target
+ * type. In [fastMin, fastMax] the product v * mul fits 64 bits, the other
+ * inputs take 128 bits integers. Without them (TYPE_NO_WIDE) the inputs are
+ * limited to |v| <= LLONG_MAX / mul, a bigger one is TS_OUTRANGE.
+ */
+struct TypeScale {
+    int from;
+    int to;
+    type_value_store mul;
+    type_value_store div;
+    unsigned long long divInv; /* floor((2^64 - 1) / div) */
+    type_value_store cut;
+    type_value_store inMin;
+    type_value_store inMax;
+    type_value_store fastMin;
+    type_value_store fastMax;
+};
+
+/* Vector instructions for the column kernels */
+enum TypeSimd {
+    TYPE_SIMD_SCALAR,
+    TYPE_SIMD_SSE42,
+    TYPE_SIMD_AVX2,
+    TYPE_SIMD_AVX512
+};
+
 /* Operation result on types */
 struct TypeResult {
     enum TypeStatus status;
     struct TypeValue out;
 };
 
+/* Column of values of the same type, stored as separate arrays.
+ * The arrays are aligned to TYPE_COLUMN_ALIGN and they are not owned by
+ * the column: the memory is provided by the caller, see type_column().
+ */
+struct TypeColumn {
+    int type;
+    int len;
+    type_value_store *values;
+#ifdef TYPE_TIMESTAMP
+    type_millisecs *timestamps;
+#endif
+};
+
+/* Column with the narrowest lanes for the range of its type:
+ * width is 1, 2, 4 or 8 bytes (int8_t, int16_t, int32_t or
+ * type_value_store), see type_width().
+ */
+struct TypeNarrow {
+    int type;
+    int len;
+    int width;
+    void *values;
+#ifdef TYPE_TIMESTAMP
+    type_millisecs *timestamps;
+#endif
+};
+
+/* Configuration of a set of types, see type_context_new() */
+struct TypeContext;
+
 typedef struct TypeValue TypeValue;
 typedef struct TypeResult TypeResult;
+typedef struct TypeContext TypeContext;
+typedef struct TypeColumn TypeColumn;
+typedef struct TypeNarrow TypeNarrow;
 typedef type_value_store type_decimal;
 
 /* create a decimal value, for range set, from a floating point */
@@ -75,10 +328,76 @@ struct TypeConf type_conf_dec(type_decimal min, type_decimal max, int precision)
 struct TypeConf type_conf_nom(int count);
 
 /* Mandatory first operation.
- * The table memory must be always available and immutable.
+ * The table is compiled in an internal copy, so the memory can be released
+ * after the call. A new call replaces the whole configuration.
+ * It configures the default context, see type_context_config().
  */
 void type_config(const struct TypeConf *table, int len);
 
+/* number of types of the configuration of the current context */
+int type_config_len(void);
+
+/* Fingerprint of the configuration of the current context: a 64 bits
+ * hash (FNV-1a) of TYPE_DECIMAL_DIGITS and of the category, range and
+ * precision of every type, e.g. to check the files written by another
+ * process.
+ */
+unsigned long long type_config_hash(void);
+
+/* 1 if the type is in the configuration and the value in its range,
+ * e.g. for the values read from outside; 0 otherwise
+ */
+int type_valid(const TypeValue tv);
+
+/* Contexts.
+ * Every context has its own configuration, so different sets of types can
+ * live in the same process. All the operations use the context bound to
+ * the current thread, or the default one (of type_config) if none.
+ * The values do not carry the context: they must be used only with the
+ * context that created them.
+ */
+
+/* create a new context with its configuration, see type_config() */
+TypeContext *type_context_new(const struct TypeConf *table, int len);
+
+/* release a context, it must not be bound to any thread */
+void type_context_free(TypeContext *ctx);
+
+/* Replace the configuration of a context, NULL is the default one. */
+void type_context_config(TypeContext *ctx, const struct TypeConf *table,
+                         int len);
+
+/* Bind the context to the current thread, NULL to use the default one.
+ * Return the context bound before, to restore it.
+ */
+TypeContext *type_context_use(TypeContext *ctx);
+
+/* Hot reconfiguration.
+ * type_config() and type_context_config() can run while other threads use
+ * the same context: the new table is published atomically and the readers
+ * take no locks. The old table is freed after a grace period, when every
+ * online thread has been quiescent at least once.
+ * The threads using a context during its reconfiguration must be online.
+ * An operation never keeps the table after its return, so a thread is
+ * quiescent between two calls.
+ * Many online threads can reconfigure or synchronize at the same time: a
+ * thread waiting for its turn counts as quiescent.
+ */
+
+/* register the current thread, before its first operation */
+void type_thread_online(void);
+
+/* unregister the current thread, before it exits or blocks for long */
+void type_thread_offline(void);
+
+/* announce that the current thread is between two operations,
+ * e.g. once per iteration of the loop of a worker
+ */
+void type_quiescent(void);
+
+/* wait until every online thread has been quiescent */
+void type_synchronize(void);
+
 /* init a new type instance at 0.
  * After init, use the corresponding set operation.
  * It should be used only with constants because
@@ -107,12 +426,40 @@ TypeResult type_seti(const TypeValue tv, type_value_store v);
 /* Set a decimal value, will be truncated to precision. */
 TypeResult type_setd(const TypeValue tv, double v);
 
+/* Set a decimal value already scaled to the internal precision (as
+ * type_dec does), will be truncated to precision.
+ * E.g. with TYPE_DECIMAL_DIGITS=3, type_setds(v, 3140) is 3.14
+ */
+TypeResult type_setds(const TypeValue tv, type_decimal v);
+
+/* Set the decimal value mantissa * 10^exp10, with integer operations only.
+ * The digits beyond the precision are truncated.
+ * E.g. type_setdec(v, 314, -2) is 3.14
+ */
+TypeResult type_setdec(const TypeValue tv, long long mantissa, int exp10);
+
 /* Set a nominal value.
  * E.g. type_setn(v, STATE_A);
  * where STATE_A is an enumeration value.
  */
 TypeResult type_setn(const TypeValue tv, int name);
 
+/* Set the value from its text representation, without floating point.
+ * The format is [+-]digits for NOMINAL and INTEGER and [+-]digits[.digits]
+ * for DECIMAL, truncated to the precision. No blanks are allowed.
+ * The str does not need the terminator, len is the number of chars.
+ * A malformed text is TS_INCOMPATIBLE.
+ */
+TypeResult type_parse(const TypeValue tv, const char *str, int len);
+
+/* Parse up to n fields of text separated by sep, as type_parse.
+ * The blanks around the fields are ignored, so sep can be '\n' for a
+ * value per line. Every field has its status.
+ * Return the number of fields parsed.
+ */
+int type_parse_n(TypeValue *out, enum TypeStatus *status, int type,
+                 const char *text, int len, char sep, int n);
+
 /* sum */
 TypeResult type_sum(const TypeValue a, const TypeValue b);
 
@@ -122,6 +469,344 @@ TypeResult type_mul(const TypeValue a, const TypeValue b);
 /* division */
 TypeResult type_div(const TypeValue a, const TypeValue b);
 
+/* Sticky status.
+ * The results of a chain of operations go through type_acc(), that keeps
+ * the failures and returns the value, so the status is checked once at the
+ * end, e.g.
+ *
+ *   struct TypeAcc acc = type_acc_init();
+ *   TypeValue x = type_acc(&acc, type_mul(gain, raw));
+ *   TypeValue y = type_acc(&acc, type_sum(x, offset));
+ *   if (acc.flags != 0) ... acc.failed is 0 or 1
+ *
+ * After a failure the returned value is clamped to the range of its type:
+ * the chain can go on, but its result is meaningless.
+ */
+struct TypeAcc type_acc_init(void);
+
+TypeValue type_acc(struct TypeAcc *acc, const TypeResult res);
+
+/* add the statuses of a batch operation, one index for each */
+void type_acc_n(struct TypeAcc *acc, const enum TypeStatus *status, int n);
+
+/* Saturating operations.
+ * The result is clamped to the range of the type and it is always valid:
+ * TS_OUTRANGE just tells that it was saturated, TS_INCOMPATIBLE as the
+ * other operations.
+ */
+TypeResult type_sum_sat(const TypeValue a, const TypeValue b);
+
+TypeResult type_mul_sat(const TypeValue a, const TypeValue b);
+
+/* Fused operations, all the values of the same type (or TS_INCOMPATIBLE).
+ * The intermediate results are exact and not checked: the final result is
+ * truncated once to the precision of the type (two times without 128 bits
+ * integers), then checked on the range. One timestamp per call.
+ */
+
+/* a * b + c */
+TypeResult type_fma(const TypeValue a, const TypeValue b, const TypeValue c);
+
+/* a + (b - a) * t, with t in [0, 1] at internal precision, e.g.
+ * type_dec(0.25)
+ */
+TypeResult type_lerp(const TypeValue a, const TypeValue b, type_decimal t);
+
+/* a + b clamped to [lo, hi], TS_OUTRANGE marks a clamped result that is
+ * still stored in out
+ */
+TypeResult type_clamp_add(const TypeValue a, const TypeValue b,
+                          const TypeValue lo, const TypeValue hi);
+
+/* Calibration of n values: out[i] = x[i] * gain + offset.
+ * The same rules of the batch operations below.
+ */
+int type_fma_n(TypeValue *out, enum TypeStatus *status, const TypeValue *x,
+               const TypeValue gain, const TypeValue offset, int n);
+
+/* Conversions between INTEGER and DECIMAL types.
+ * The scale from -> to is num / den (both positive) on the values as they
+ * are read, e.g. Hz to kHz is type_scale(HZ, KHZ, 1, 1000).
+ * It is computed once for the current configuration, with the precision
+ * of the target type, and it must be built again after a configuration.
+ * It aborts if the scale does not fit 64 bits.
+ */
+struct TypeScale type_scale(int from, int to, long long num, long long den);
+
+/* Convert with integer operations only.
+ * The result is truncated to the precision of the target type and checked
+ * on its range (TS_OUTRANGE). A value not of the type from, or a NOMINAL
+ * type, is TS_INCOMPATIBLE.
+ */
+TypeResult type_convert(const struct TypeScale *s, const TypeValue tv);
+
+/* Convert n values, the same rules of the batch operations below */
+int type_convert_n(TypeValue *out, enum TypeStatus *status,
+                   const struct TypeScale *s, const TypeValue *in, int n);
+
+/* Batch operations on n pairs: out[i] = a[i] op b[i].
+ * The type is the one of a[0], the dispatch is done once for the whole batch
+ * and the pairs of a different type are TS_INCOMPATIBLE.
+ * The status of every pair is written in status[i], the caller must use
+ * only the out values with TS_OK. The out array can be the same as a or b.
+ * With TYPE_TIMESTAMP, all the results get the same timestamp.
+ * Return the number of pairs with a status different from TS_OK.
+ */
+int type_sum_n(TypeValue *out, enum TypeStatus *status,
+               const TypeValue *a, const TypeValue *b, int n);
+
+int type_mul_n(TypeValue *out, enum TypeStatus *status,
+               const TypeValue *a, const TypeValue *b, int n);
+
+int type_div_n(TypeValue *out, enum TypeStatus *status,
+               const TypeValue *a, const TypeValue *b, int n);
+
+/* Saturating batch operations, the status can be NULL.
+ * Return the number of saturated or incompatible pairs.
+ */
+int type_sum_sat_n(TypeValue *out, enum TypeStatus *status,
+                   const TypeValue *a, const TypeValue *b, int n);
+
+int type_mul_sat_n(TypeValue *out, enum TypeStatus *status,
+                   const TypeValue *a, const TypeValue *b, int n);
+
+/* Packed values.
+ * A type can be packed when its index is below 2^TYPE_PACK_TYPE_BITS and
+ * its range fits the signed 64 - TYPE_PACK_TYPE_BITS bits of the value.
+ * The configuration checks every type, see type_packable().
+ * The operations on the packed values are the same of the unpacked ones.
+ */
+
+/* 1 if the values of the type can be packed, 0 otherwise */
+int type_packable(int type);
+
+/* TS_INCOMPATIBLE if the type cannot be packed, out is left untouched */
+enum TypeStatus type_pack(type_packed *out, const TypeValue tv);
+
+/* the timestamp, if any, is 0 as in type_init() */
+TypeValue type_unpack(type_packed p);
+
+/* return the number of values not packed */
+int type_pack_n(type_packed *out, enum TypeStatus *status,
+                const TypeValue *tv, int n);
+
+void type_unpack_n(TypeValue *out, const type_packed *p, int n);
+
+struct TypePackedResult type_pack_sum(type_packed a, type_packed b);
+struct TypePackedResult type_pack_mul(type_packed a, type_packed b);
+struct TypePackedResult type_pack_div(type_packed a, type_packed b);
+
+/* Size in bytes of the memory for a column of len values.
+ * It includes the padding for the alignment.
+ */
+size_t type_column_size(int len);
+
+/* Create a column of len values at 0 on the memory mem.
+ * The memory must be at least type_column_size(len) bytes and it must be
+ * available for the whole life of the column.
+ * It validates the type and abort in case of error.
+ */
+TypeColumn type_column(int type, void *mem, int len);
+
+/* get a copy of the i-th value */
+TypeValue type_column_get(const TypeColumn *col, int i);
+
+/* store a value in the i-th position.
+ * The value must be of the column type, otherwise TS_INCOMPATIBLE.
+ */
+enum TypeStatus type_column_put(TypeColumn *col, int i, const TypeValue tv);
+
+/* Column-wide operations.
+ * The status of every element is written in status[i] (col->len elements).
+ * Only the results with TS_OK are stored, the other elements keep the
+ * previous value, so the column always holds valid values.
+ * Return the number of elements with a status different from TS_OK.
+ */
+
+/* Set all the values from v (col->len elements).
+ * For the DECIMAL types, v is already scaled (see type_dec) and it is
+ * truncated to the precision.
+ */
+int type_column_set(TypeColumn *col, enum TypeStatus *status,
+                    const type_value_store *v);
+
+/* Parse up to col->len fields of text separated by sep, see type_parse_n.
+ * Return the number of fields parsed.
+ */
+int type_column_parse(TypeColumn *col, enum TypeStatus *status,
+                      const char *text, int len, char sep);
+
+/* out[i] = a[i] op b[i], all the columns must have the same type and len */
+int type_column_sum(TypeColumn *out, enum TypeStatus *status,
+                    const TypeColumn *a, const TypeColumn *b);
+
+int type_column_mul(TypeColumn *out, enum TypeStatus *status,
+                    const TypeColumn *a, const TypeColumn *b);
+
+int type_column_div(TypeColumn *out, enum TypeStatus *status,
+                    const TypeColumn *a, const TypeColumn *b);
+
+/* out[i] = a[i] + b[i] clamped to the type range.
+ * The results are always stored, the saturated ones have TS_OUTRANGE.
+ * Return the number of saturated elements (or TS_INCOMPATIBLE for all if
+ * the columns have different types or the type is NOMINAL).
+ */
+int type_column_sum_sat(TypeColumn *out, enum TypeStatus *status,
+                        const TypeColumn *a, const TypeColumn *b);
+
+/* out[i] = in[i] converted, see type_convert().
+ * The columns are of the types of the scale, with the same len.
+ */
+int type_column_convert(TypeColumn *out, enum TypeStatus *status,
+                        const struct TypeScale *s, const TypeColumn *in);
+
+/* Check the range of all the values, e.g. for memory from outside.
+ * The status can be NULL when only the count is needed.
+ * Return the number of values out of range.
+ */
+int type_column_validate(const TypeColumn *col, enum TypeStatus *status);
+
+/* Clamp all the values to the type range.
+ * The status (can be NULL) marks the clamped values with TS_OUTRANGE.
+ * Return the number of clamped values.
+ */
+int type_column_clamp(TypeColumn *col, enum TypeStatus *status);
+
+/* Narrow columns.
+ * The same of the columns, but the lanes are as narrow as the range of
+ * the type allows (a DECIMAL range is in internal precision, not in the
+ * precision of the type: the products keep the digits beyond it, as
+ * type_mul()).
+ * The width depends on the configuration at the creation: a column must not
+ * be used after a configuration with a wider range.
+ */
+
+/* bytes of a lane for the type: 1, 2, 4 or 8 */
+int type_width(int type);
+
+/* see type_column_size() and type_column() */
+size_t type_narrow_size(int type, int len);
+
+TypeNarrow type_narrow(int type, void *mem, int len);
+
+TypeValue type_narrow_get(const TypeNarrow *col, int i);
+
+enum TypeStatus type_narrow_put(TypeNarrow *col, int i, const TypeValue tv);
+
+int type_narrow_set(TypeNarrow *col, enum TypeStatus *status,
+                    const type_value_store *v);
+
+/* out[i] = a[i] op b[i], computed at 64 bits */
+int type_narrow_sum(TypeNarrow *out, enum TypeStatus *status,
+                    const TypeNarrow *a, const TypeNarrow *b);
+
+int type_narrow_mul(TypeNarrow *out, enum TypeStatus *status,
+                    const TypeNarrow *a, const TypeNarrow *b);
+
+int type_narrow_div(TypeNarrow *out, enum TypeStatus *status,
+                    const TypeNarrow *a, const TypeNarrow *b);
+
+/* see type_column_validate() */
+int type_narrow_validate(const TypeNarrow *col, enum TypeStatus *status);
+
+/* Reductions.
+ * The total is accumulated exactly and checked on the range of the type
+ * only at the end: TS_OUTRANGE if it does not fit, but min, max and mean
+ * (truncated to the precision) are valid anyway.
+ * TS_INCOMPATIBLE for NOMINAL types and, on arrays, for mixed types.
+ * At least one value is needed.
+ */
+struct TypeReduction type_reduce_n(const TypeValue *v, int n);
+
+struct TypeReduction type_column_reduce(const TypeColumn *col);
+
+/* the same, on slices of the column in up to threads threads */
+struct TypeReduction type_column_reduce_mt(const TypeColumn *col, int threads);
+
+/* number of values of the type of lo in [lo, hi] */
+int type_count_n(const TypeValue *v, int n, const TypeValue lo,
+                 const TypeValue hi);
+
+int type_column_count(const TypeColumn *col, const TypeValue lo,
+                      const TypeValue hi);
+
+/* Rings.
+ * Bounded lock-free queues of TypeValue or of packed values, e.g. from the
+ * acquisition threads to the processing ones, in FIFO order.
+ * TYPE_RING_SPSC has one producer and one consumer thread, TYPE_RING_MPSC
+ * any number of producers and one consumer. The positions of the producers
+ * and of the consumer are on separate cache lines.
+ * The memory is provided by the caller, as for the columns, and the
+ * capacity is a power of 2.
+ */
+
+enum TypeRingMode {
+    TYPE_RING_SPSC,
+    TYPE_RING_MPSC
+};
+
+/* Ring in the memory of the caller, see type_ring() */
+struct TypeRing;
+typedef struct TypeRing TypeRing;
+
+/* Size in bytes of the memory for a ring of capacity values.
+ * It includes the padding for the alignment.
+ */
+size_t type_ring_size(int capacity);
+
+size_t type_ring_packed_size(int capacity);
+
+/* Create an empty ring on the memory mem, see type_ring_size().
+ * The memory must be available for the whole life of the ring.
+ */
+TypeRing *type_ring(void *mem, int capacity, enum TypeRingMode mode);
+
+TypeRing *type_ring_packed(void *mem, int capacity, enum TypeRingMode mode);
+
+/* Push up to n values, in order, without waiting.
+ * Return the number pushed, less than n when the ring is full.
+ */
+int type_ring_push_n(TypeRing *r, const TypeValue *v, int n);
+
+/* Pop up to n values, without waiting.
+ * Return the number popped, 0 when the ring is empty.
+ * With TYPE_RING_MPSC a value still being copied by its producer stops
+ * the batch, the values after it are returned by the next pop.
+ */
+int type_ring_pop_n(TypeRing *r, TypeValue *out, int n);
+
+/* the same for a ring of packed values */
+int type_ring_push_packed_n(TypeRing *r, const type_packed *p, int n);
+
+int type_ring_pop_packed_n(TypeRing *r, type_packed *out, int n);
+
+/* Pop up to col->len values in the column, from the first element, as
+ * type_column_put(): the values of another type have TS_INCOMPATIBLE and
+ * they are not stored. The status can be NULL.
+ * Return the number of values popped.
+ */
+int type_ring_pop_column(TypeRing *r, TypeColumn *col,
+                         enum TypeStatus *status);
+
+/* number of values in the ring, it can be old as soon as it returns */
+int type_ring_count(const TypeRing *r);
+
+/* The column kernels use the best vector instructions of the CPU,
+ * selected at the first use of the kernels unless type_simd_set() came
+ * first. Without x86 or with TYPE_NO_SIMD, the scalar version is always
+ * used. The results are the same at every level.
+ */
+
+/* get the current level */
+enum TypeSimd type_simd(void);
+
+/* Force a level, e.g. for tests and benchmarks.
+ * A level not supported by the CPU is lowered to the best available.
+ * Return the level actually selected. It can run while other threads use
+ * the columns, an operation runs on the old or the new kernels.
+ */
+enum TypeSimd type_simd_set(enum TypeSimd level);
+
 /* get the representation of the value in string format.
  * The nominal values are just the integer represenration.
  * The decimal values show the precision digits, pad with zeros.
@@ -130,6 +815,61 @@ TypeResult type_div(const TypeValue a, const TypeValue b);
  */
 void type_str(char *buf, const TypeValue tv);
 
+/* Write the representation of n values in buf, separated by sep.
+ * The buf of size bytes is always terminated, the values are never cut.
+ * Return the number of bytes written without the terminator, or -1 if the
+ * buf is too small (it contains the values that fit).
+ */
+int type_str_n(char *buf, int size, const TypeValue *tv, int n, char sep);
+
+#ifdef TYPE_STATS
+/* Operation counters.
+ * Every thread counts in its own counters, padded on the cache lines, with
+ * no locks nor atomic instructions. The counters of the ended threads are
+ * kept. Without TYPE_STATS the counting is not compiled at all.
+ */
+
+/* snapshot of the counters of all the threads */
+void type_stats(struct TypeStats *out);
+
+/* snapshot of the counters of the current thread */
+void type_stats_thread(struct TypeStats *out);
+
+/* out += in, e.g. for the snapshots of many processes */
+void type_stats_merge(struct TypeStats *out, const struct TypeStats *in);
+#endif
+
+#ifdef TYPE_PROFILE
+/* Latency profiling.
+ * A sampled call reads the TSC (clock_gettime on the other architectures
+ * or with TYPE_PROFILE_CLOCK) at the begin and at the end, and adds the
+ * sample to the histograms of the current thread, padded on the cache
+ * lines as the counters of TYPE_STATS. With TYPE_PROFILE_PERIOD above 1
+ * the other calls do not read the clock at all.
+ * The nested operations (e.g. type_setd calls type_setds) are measured
+ * both.
+ */
+
+/* snapshot of the histograms of all the threads, also the ended ones */
+void type_profile(struct TypeProfile *out);
+
+/* snapshot of the histograms of the current thread */
+void type_profile_thread(struct TypeProfile *out);
+
+/* out += in, the profiles must be of builds with the same assertions and
+ * unit
+ */
+void type_profile_merge(struct TypeProfile *out, const struct TypeProfile *in);
+
+/* Write a CSV line for every operation and category with samples:
+ *
+ * op,category,asserts,unit,count,mean,p50,p90,p99,max
+ *
+ * The percentiles are the upper bound of their bucket.
+ */
+void type_profile_dump(FILE *out, const struct TypeProfile *p);
+#endif
+
 #ifdef TYPE_TIMESTAMP
 
 /* TO BE PROVIDED BY THE USER.
@@ -144,4 +884,57 @@ type_millisecs type_now(void);
 
 /* Retrieve the timestamp of the last change of the value. */
 type_millisecs type_get_time(const TypeValue tv);
+
+/* Time scope, e.g. a control cycle.
+ * Between begin and end, all the values set or computed by the current
+ * thread get the same timestamp, read once with type_now() at the begin.
+ * The scopes cannot be nested.
+ */
+void type_time_begin(void);
+
+/* as type_time_begin, with the time given by the caller */
+void type_time_begin_at(type_millisecs now);
+
+void type_time_end(void);
+
+/* Staleness index.
+ * The last timestamp of a set of channels (0 .. channels - 1, e.g. the
+ * inputs of a watchdog), ordered by time: a query costs the number of
+ * stale channels, not a scan of all of them.
+ * An update is O(1) with the timestamps of type_now(), an older timestamp
+ * costs the number of channels updated after it.
+ * The memory is provided by the caller, as for the columns. Not thread safe.
+ */
+struct TypeStale;
+typedef struct TypeStale TypeStale;
+
+/* Size in bytes of the memory for the index, with the alignment padding */
+size_t type_stale_size(int channels);
+
+/* Create the index on mem, all the channels with timestamp 0
+ * (never set, so stale for any deadline greater than 0).
+ */
+TypeStale *type_stale(void *mem, int channels);
+
+/* set the timestamp of the channel */
+void type_stale_touch(TypeStale *s, int ch, type_millisecs time);
+
+/* the channel has the value tv, see type_get_time() */
+void type_stale_put(TypeStale *s, int ch, const TypeValue tv);
+
+/* The channel ch[i] has the value tv[i], e.g. the results of a batch
+ * operation. The status can be NULL, only the values with TS_OK are
+ * indexed. Return the number of values not indexed.
+ */
+int type_stale_put_n(TypeStale *s, const int *ch, const TypeValue *tv,
+                     const enum TypeStatus *status, int n);
+
+type_millisecs type_stale_time(const TypeStale *s, int ch);
+
+/* Write in out up to max channels with a timestamp older than (less than)
+ * the deadline, the oldest first.
+ * Return the number of channels written.
+ */
+int type_stale_query(const TypeStale *s, type_millisecs deadline, int *out,
+                     int max);
 #endif
@@ -0,0 +1,654 @@
+/*
+ * Column files, see strongtypes_file.h
+ *
+ * Version: v1.0.0
+ */
+
+#define _POSIX_C_SOURCE 200112L /* fdopen, ftruncate */
+
+#include "strongtypes_file.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sched.h>
+
+/* written as it is, a reader with another byte order sees it reversed */
+#define FILE_BYTE_ORDER     0x0102030405060708ULL
+
+/* Header of the file, 64 bytes */
+struct FileHeader {
+    char magic[8];          /* TYPE_FILE_MAGIC without the terminator */
+    uint32_t version;
+    uint32_t stampSize;     /* bytes of a timestamp, 0 without timestamps */
+    uint64_t byteOrder;     /* FILE_BYTE_ORDER */
+    uint64_t configHash;    /* type_config_hash() of the writer */
+    uint32_t columns;
+    uint32_t reserved1;
+    uint64_t size;          /* of the whole file */
+    uint8_t reserved2[16];
+};
+
+/* Column in the directory, 32 bytes */
+struct FileEntry {
+    int32_t type;
+    uint32_t reserved;
+    int64_t len;
+    uint64_t values;        /* offset from the file start */
+    uint64_t timestamps;    /* offset, 0 without timestamps */
+};
+
+/* the layout must not depend on the compiler */
+typedef char header_size_check[(sizeof(struct FileHeader) == 64) ? 1 : -1];
+typedef char entry_size_check[(sizeof(struct FileEntry) == 32) ? 1 : -1];
+
+static
+uint64_t file_round(uint64_t bytes)
+{
+    return (bytes + TYPE_COLUMN_ALIGN - 1) & ~(uint64_t)(TYPE_COLUMN_ALIGN - 1);
+}/* file_round */
+
+static
+size_t file_stamp_size(void)
+{
+#ifdef TYPE_TIMESTAMP
+    return sizeof(type_millisecs);
+#else
+    return 0;
+#endif
+}/* file_stamp_size */
+
+/* write zeros up to the offset */
+static
+int file_pad(FILE *out, uint64_t *pos, uint64_t offset)
+{
+    static const char zeros[TYPE_COLUMN_ALIGN];
+
+    while (*pos < offset){
+        size_t n = (offset - *pos < sizeof(zeros)) ? (size_t)(offset - *pos)
+                                                   : sizeof(zeros);
+        if (fwrite(zeros, 1, n, out) != n){
+            return -1;
+        }
+        *pos += n;
+    }
+
+    return 0;
+}/* file_pad */
+
+static
+int file_put(FILE *out, uint64_t *pos, const void *data, size_t bytes)
+{
+    if (bytes > 0 && fwrite(data, 1, bytes, out) != bytes){
+        return -1;
+    }
+
+    *pos += bytes;
+    return 0;
+}/* file_put */
+
+/* Create a new file next to path, to be renamed over it when complete:
+ * the processes that still map the old file keep it whole.
+ * Return the descriptor, -1 on error. tmp is malloc'ed, also on error.
+ */
+static
+int file_temp(char **tmp, const char *path)
+{
+    const size_t size = strlen(path) + 32;
+
+    *tmp = malloc(size);
+    if (*tmp == NULL){
+        return -1;
+    }
+    snprintf(*tmp, size, "%s.%ld.tmp", path, (long)getpid());
+
+    return open(*tmp, O_RDWR | O_CREAT | O_EXCL, 0644);
+}/* file_temp */
+
+/* rename tmp over path if ok, otherwise remove it */
+static
+int file_commit(char *tmp, const char *path, int ok)
+{
+    int rc = -1;
+
+    if (ok){
+        rc = rename(tmp, path);
+    }
+    if (rc != 0){
+        unlink(tmp);
+    }
+
+    free(tmp);
+    return rc;
+}/* file_commit */
+
+enum TypeFileStatus type_file_write(const char *path, const TypeColumn *cols,
+                                    int n)
+{
+    assert(path != NULL);
+    assert(n >= 0);
+    assert(n == 0 || cols != NULL);
+
+    const size_t stampSize = file_stamp_size();
+    struct FileEntry *dir = calloc((size_t)n + 1, sizeof(struct FileEntry));
+    if (dir == NULL){
+        return TF_IO;
+    }
+
+    /* the layout first, the header has the size */
+    uint64_t off = file_round(sizeof(struct FileHeader) +
+                              (uint64_t)n * sizeof(struct FileEntry));
+    for (int i=0; i < n; i++){
+        assert(cols[i].len >= 0);
+
+        dir[i].type = cols[i].type;
+        dir[i].len = cols[i].len;
+        dir[i].values = off;
+        off += file_round((uint64_t)cols[i].len * sizeof(type_value_store));
+        if (stampSize > 0){
+            dir[i].timestamps = off;
+            off += file_round((uint64_t)cols[i].len * stampSize);
+        }
+    }
+
+    struct FileHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, TYPE_FILE_MAGIC, sizeof(h.magic));
+    h.version = TYPE_FILE_VERSION;
+    h.stampSize = (uint32_t)stampSize;
+    h.byteOrder = FILE_BYTE_ORDER;
+    h.configHash = type_config_hash();
+    h.columns = (uint32_t)n;
+    h.size = off;
+
+    char *tmp;
+    int fd = file_temp(&tmp, path);
+    FILE *out = (fd >= 0) ? fdopen(fd, "wb") : NULL;
+    if (out == NULL){
+        if (fd >= 0){
+            close(fd);
+            unlink(tmp);
+        }
+        free(tmp);
+        free(dir);
+        return TF_IO;
+    }
+
+    uint64_t pos = 0;
+    int rc = file_put(out, &pos, &h, sizeof(h));
+    rc |= file_put(out, &pos, dir, (size_t)n * sizeof(struct FileEntry));
+
+    for (int i=0; i < n && rc == 0; i++){
+        const size_t len = (size_t)cols[i].len;
+
+        rc |= file_pad(out, &pos, dir[i].values);
+        rc |= file_put(out, &pos, cols[i].values,
+                       len * sizeof(type_value_store));
+#ifdef TYPE_TIMESTAMP
+        rc |= file_pad(out, &pos, dir[i].timestamps);
+        rc |= file_put(out, &pos, cols[i].timestamps, len * stampSize);
+#endif
+    }
+    rc |= file_pad(out, &pos, off);
+
+    free(dir);
+    rc |= fclose(out);
+    rc |= file_commit(tmp, path, rc == 0);
+
+    return (rc == 0) ? TF_OK : TF_IO;
+}/* type_file_write */
+
+static
+const struct FileEntry *file_entry(const TypeFile *f, int i)
+{
+    return (const struct FileEntry *)((const char *)f->map +
+                                      sizeof(struct FileHeader)) + i;
+}/* file_entry */
+
+/* the array of len elements at offset is aligned and in the file */
+static
+int file_array_valid(const TypeFile *f, uint64_t offset, int64_t len,
+                     size_t elem)
+{
+    return (offset % TYPE_COLUMN_ALIGN == 0) &&
+           (offset <= f->size) &&
+           ((uint64_t)len * elem <= f->size - offset);
+}/* file_array_valid */
+
+/* the header, the directory and then the values */
+static
+enum TypeFileStatus file_check(TypeFile *f)
+{
+    const struct FileHeader *h = f->map;
+
+    if (memcmp(h->magic, TYPE_FILE_MAGIC, sizeof(h->magic)) != 0 ||
+        h->version != TYPE_FILE_VERSION ||
+        h->byteOrder != FILE_BYTE_ORDER ||
+        h->size != f->size){
+        return TF_FORMAT;
+    }
+
+    if (h->configHash != type_config_hash()){
+        return TF_CONFIG;
+    }
+
+    const size_t stampSize = file_stamp_size();
+    if (stampSize > 0 && h->stampSize != stampSize){
+        return TF_FORMAT;
+    }
+
+    if (h->columns > INT_MAX ||
+        (uint64_t)h->columns * sizeof(struct FileEntry) >
+        f->size - sizeof(struct FileHeader)){
+        return TF_FORMAT;
+    }
+    f->columns = (int)h->columns;
+
+    for (int i=0; i < f->columns; i++){
+        const struct FileEntry *e = file_entry(f, i);
+
+        if (e->type < 0 || e->type >= type_config_len() ||
+            e->len < 0 || e->len > INT_MAX ||
+            !file_array_valid(f, e->values, e->len,
+                              sizeof(type_value_store)) ||
+            (stampSize > 0 &&
+             !file_array_valid(f, e->timestamps, e->len, stampSize))){
+            return TF_FORMAT;
+        }
+    }
+
+    /* the values can be written by anybody */
+    for (int i=0; i < f->columns; i++){
+        TypeColumn col = type_file_column(f, i);
+
+        if (type_column_validate(&col, NULL) > 0){
+            return TF_OUTRANGE;
+        }
+    }
+
+    return TF_OK;
+}/* file_check */
+
+enum TypeFileStatus type_file_open(TypeFile *f, const char *path)
+{
+    assert(f != NULL && path != NULL);
+
+    f->map = NULL;
+    f->size = 0;
+    f->columns = 0;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0){
+        return TF_IO;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0){
+        close(fd);
+        return TF_IO;
+    }
+
+    if (st.st_size < (off_t)sizeof(struct FileHeader)){
+        close(fd);
+        return TF_FORMAT;
+    }
+
+    /* private: the columns can be changed, the file stays the same */
+    TypeFile tmp = {.map = NULL, .size = (size_t)st.st_size, .columns = 0};
+    tmp.map = mmap(NULL, tmp.size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+
+    if (tmp.map == MAP_FAILED){
+        return TF_IO;
+    }
+
+    enum TypeFileStatus status = file_check(&tmp);
+    if (status != TF_OK){
+        munmap(tmp.map, tmp.size);
+        return status;
+    }
+
+    *f = tmp;
+    return TF_OK;
+}/* type_file_open */
+
+TypeColumn type_file_column(const TypeFile *f, int i)
+{
+    assert(f != NULL && f->map != NULL);
+    assert(i >= 0 && i < f->columns);
+
+    const struct FileEntry *e = file_entry(f, i);
+    char *base = f->map;
+
+    TypeColumn col = {.type = e->type, .len = (int)e->len};
+    col.values = (type_value_store *)(base + e->values);
+#ifdef TYPE_TIMESTAMP
+    col.timestamps = (type_millisecs *)(base + e->timestamps);
+#endif
+    return col;
+}/* type_file_column */
+
+void type_file_close(TypeFile *f)
+{
+    assert(f != NULL);
+
+    if (f->map != NULL){
+        munmap(f->map, f->size);
+    }
+
+    f->map = NULL;
+    f->size = 0;
+    f->columns = 0;
+}/* type_file_close */
+
+/* Shared stores.
+ * The writer fills the header and the slots in a new file, writes the
+ * magic and then renames the file over the path.
+ * The fields of the slots are accessed with atomic loads and stores, the
+ * counter orders them (release by the writer, acquire by the readers).
+ */
+
+/* Header of the store, 64 bytes */
+struct SharedHeader {
+    char magic[8];          /* TYPE_SHARED_MAGIC, written last */
+    uint32_t version;
+    uint32_t channels;
+    uint64_t byteOrder;     /* FILE_BYTE_ORDER */
+    uint64_t configHash;    /* type_config_hash() of the writer */
+    uint64_t size;          /* of the whole store */
+    uint8_t reserved[24];
+};
+
+/* Channel, a cache line */
+struct SharedSlot {
+    uint64_t seq;           /* odd while the writer changes the value */
+    int32_t type;
+    uint32_t reserved;
+    int64_t value;
+    uint64_t timestamp;     /* 0 without TYPE_TIMESTAMP */
+    uint8_t pad[32];
+};
+
+typedef char shared_header_check[(sizeof(struct SharedHeader) == 64) ? 1 : -1];
+typedef char shared_slot_check[(sizeof(struct SharedSlot) == 64) ? 1 : -1];
+
+static
+struct SharedSlot *shared_slot(const TypeShared *sh, int ch)
+{
+    assert(sh != NULL && sh->map != NULL);
+    assert(ch >= 0 && ch < sh->channels);
+
+    return (struct SharedSlot *)((char *)sh->map +
+                                 sizeof(struct SharedHeader)) + ch;
+}/* shared_slot */
+
+static
+uint64_t shared_size(uint64_t channels)
+{
+    return sizeof(struct SharedHeader) + channels * sizeof(struct SharedSlot);
+}/* shared_size */
+
+enum TypeFileStatus type_shared_create(TypeShared *sh, const char *path,
+                                       const int *types, int channels)
+{
+    assert(sh != NULL && path != NULL);
+    assert(channels >= 0);
+    assert(channels == 0 || types != NULL);
+
+    sh->map = NULL;
+    sh->size = 0;
+    sh->channels = 0;
+    sh->writer = 0;
+
+    for (int i=0; i < channels; i++){
+        if (types[i] < 0 || types[i] >= type_config_len()){
+            return TF_CONFIG;
+        }
+    }
+
+    char *tmp;
+    int fd = file_temp(&tmp, path);
+    if (fd < 0){
+        free(tmp);
+        return TF_IO;
+    }
+
+    const size_t size = (size_t)shared_size((uint64_t)channels);
+    void *map = MAP_FAILED;
+    if (ftruncate(fd, (off_t)size) == 0){
+        map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+
+    if (map == MAP_FAILED){
+        file_commit(tmp, path, 0);
+        return TF_IO;
+    }
+
+    TypeShared tmpStore = {.map = map, .size = size, .channels = channels,
+                           .writer = 1};
+
+    for (int i=0; i < channels; i++){
+        struct SharedSlot *slot = shared_slot(&tmpStore, i);
+        TypeValue tv = type_init(types[i]);
+
+        slot->type = tv.type;
+        slot->value = tv.value;
+#ifdef TYPE_TIMESTAMP
+        slot->timestamp = tv.timestamp;
+#endif
+    }
+
+    struct SharedHeader *h = map;
+    h->version = TYPE_SHARED_VERSION;
+    h->channels = (uint32_t)channels;
+    h->byteOrder = FILE_BYTE_ORDER;
+    h->configHash = type_config_hash();
+    h->size = size;
+    memcpy(h->magic, TYPE_SHARED_MAGIC, sizeof(h->magic));
+
+    /* the readers find it complete */
+    if (file_commit(tmp, path, 1) != 0){
+        munmap(map, size);
+        return TF_IO;
+    }
+
+    *sh = tmpStore;
+    return TF_OK;
+}/* type_shared_create */
+
+static
+enum TypeFileStatus shared_check(const TypeShared *sh)
+{
+    const struct SharedHeader *h = sh->map;
+
+    if (memcmp(h->magic, TYPE_SHARED_MAGIC, sizeof(h->magic)) != 0 ||
+        h->version != TYPE_SHARED_VERSION ||
+        h->byteOrder != FILE_BYTE_ORDER ||
+        h->size != sh->size ||
+        h->size != shared_size(h->channels) ||
+        h->channels > INT_MAX){
+        return TF_FORMAT;
+    }
+
+    if (h->configHash != type_config_hash()){
+        return TF_CONFIG;
+    }
+
+    return TF_OK;
+}/* shared_check */
+
+enum TypeFileStatus type_shared_open(TypeShared *sh, const char *path)
+{
+    assert(sh != NULL && path != NULL);
+
+    sh->map = NULL;
+    sh->size = 0;
+    sh->channels = 0;
+    sh->writer = 0;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0){
+        return TF_IO;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0){
+        close(fd);
+        return TF_IO;
+    }
+
+    if (st.st_size < (off_t)sizeof(struct SharedHeader)){
+        close(fd);
+        return TF_FORMAT;
+    }
+
+    TypeShared tmp = {.map = NULL, .size = (size_t)st.st_size};
+    tmp.map = mmap(NULL, tmp.size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+
+    if (tmp.map == MAP_FAILED){
+        return TF_IO;
+    }
+
+    enum TypeFileStatus status = shared_check(&tmp);
+    tmp.channels = (int)((const struct SharedHeader *)tmp.map)->channels;
+
+    /* the types are fixed at the creation, the values can be anything */
+    for (int i=0; i < tmp.channels && status == TF_OK; i++){
+        int32_t type = __atomic_load_n(&shared_slot(&tmp, i)->type,
+                                       __ATOMIC_RELAXED);
+        TypeValue tv;
+
+        if (type < 0 || type >= type_config_len()){
+            status = TF_FORMAT;
+        } else {
+            status = type_shared_get(&tmp, i, &tv);
+            if (status == TF_OK && !type_valid(tv)){
+                status = TF_OUTRANGE;
+            }
+        }
+    }
+
+    if (status != TF_OK){
+        munmap(tmp.map, tmp.size);
+        return status;
+    }
+
+    *sh = tmp;
+    return TF_OK;
+}/* type_shared_open */
+
+enum TypeStatus type_shared_put(TypeShared *sh, int ch, const TypeValue tv)
+{
+    assert(sh != NULL && sh->writer);
+    assert(type_valid(tv));
+
+    struct SharedSlot *slot = shared_slot(sh, ch);
+    if (tv.type != slot->type){
+        return TS_INCOMPATIBLE;
+    }
+
+    /* single writer, nobody else changes the counter */
+    const uint64_t seq = slot->seq;
+
+    __atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    __atomic_store_n(&slot->value, tv.value, __ATOMIC_RELAXED);
+#ifdef TYPE_TIMESTAMP
+    __atomic_store_n(&slot->timestamp, tv.timestamp, __ATOMIC_RELAXED);
+#endif
+
+    __atomic_store_n(&slot->seq, seq + 2, __ATOMIC_RELEASE);
+    return TS_OK;
+}/* type_shared_put */
+
+int type_shared_put_n(TypeShared *sh, int first, const TypeValue *tv,
+                      const enum TypeStatus *status, int n)
+{
+    assert(sh != NULL);
+    assert(n >= 0 && first >= 0 && first + n <= sh->channels);
+    assert(n == 0 || tv != NULL);
+
+    int failed = 0;
+
+    for (int i=0; i < n; i++){
+        if ((status != NULL && status[i] != TS_OK) ||
+            type_shared_put(sh, first + i, tv[i]) != TS_OK){
+            failed++;
+        }
+    }
+
+    return failed;
+}/* type_shared_put_n */
+
+enum TypeFileStatus type_shared_get(const TypeShared *sh, int ch,
+                                    TypeValue *out)
+{
+    assert(out != NULL);
+
+    const struct SharedSlot *slot = shared_slot(sh, ch);
+    TypeValue tv = {.type = slot->type}; /* no type_now() */
+
+    for (int i=0; i < TYPE_SHARED_RETRIES; i++){
+        uint64_t before = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (before & 1){
+            sched_yield(); /* the writer is in the middle */
+            continue;
+        }
+
+        tv.value = __atomic_load_n(&slot->value, __ATOMIC_RELAXED);
+#ifdef TYPE_TIMESTAMP
+        tv.timestamp = __atomic_load_n(&slot->timestamp, __ATOMIC_RELAXED);
+#endif
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) == before){
+            *out = tv;
+            return TF_OK;
+        }
+    }
+
+    return TF_BUSY;
+}/* type_shared_get */
+
+int type_shared_get_n(const TypeShared *sh, int first, TypeValue *out,
+                      enum TypeFileStatus *status, int n)
+{
+    assert(sh != NULL);
+    assert(n >= 0 && first >= 0 && first + n <= sh->channels);
+    assert(n == 0 || out != NULL);
+
+    int busy = 0;
+
+    for (int i=0; i < n; i++){
+        enum TypeFileStatus st = type_shared_get(sh, first + i, &out[i]);
+        if (status != NULL){
+            status[i] = st;
+        }
+        busy += (st != TF_OK);
+    }
+
+    return busy;
+}/* type_shared_get_n */
+
+void type_shared_close(TypeShared *sh)
+{
+    assert(sh != NULL);
+
+    if (sh->map != NULL){
+        munmap(sh->map, sh->size);
+    }
+
+    sh->map = NULL;
+    sh->size = 0;
+    sh->channels = 0;
+    sh->writer = 0;
+}/* type_shared_close */
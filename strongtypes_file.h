@@ -0,0 +1,148 @@
+#pragma once
+
+/*
+ * Column files and shared stores.
+ * A binary file with a set of columns, see TypeColumn, that can be mapped
+ * in memory and used without copies.
+ *
+ * Layout (version 1), all the integers in the byte order of the writer:
+ *
+ *   header      64 bytes, see TYPE_FILE_MAGIC
+ *   directory   32 bytes for every column: type, len and the offsets
+ *   columns     the values and then the timestamps of every column,
+ *               each array aligned to TYPE_COLUMN_ALIGN
+ *
+ * The header has the fingerprint of the configuration (type_config_hash),
+ * so a file is read only with the configuration that wrote it.
+ * It needs POSIX (mmap).
+ *
+ * Version: v1.0.0
+ */
+
+#include "strongtypes.h"
+
+#define TYPE_FILE_MAGIC     "STYPECOL"
+#define TYPE_FILE_VERSION   1
+
+enum TypeFileStatus {
+    TF_OK,
+    TF_IO,          /* system error, see errno */
+    TF_FORMAT,      /* not a column file of this version and byte order */
+    TF_CONFIG,      /* written with another configuration */
+    TF_OUTRANGE,    /* a value out of the range of its type */
+    TF_BUSY         /* a shared channel in an update that does not end */
+};
+
+/* A column file mapped in memory, see type_file_open() */
+struct TypeFile {
+    void *map;
+    size_t size;
+    int columns;
+};
+
+typedef struct TypeFile TypeFile;
+
+/* Write n columns in the file at path, replacing it.
+ * The file is written apart and renamed over path when complete, so the
+ * processes that map the old file keep it whole.
+ * Without TYPE_TIMESTAMP the file has no timestamps.
+ */
+enum TypeFileStatus type_file_write(const char *path, const TypeColumn *cols,
+                                    int n);
+
+/* Map the file at path.
+ * The header is checked against the current configuration, then all the
+ * values are checked on the range of their types (one vector pass for
+ * every column). On error nothing is left open.
+ * With TYPE_TIMESTAMP, a file without timestamps is TF_FORMAT.
+ */
+enum TypeFileStatus type_file_open(TypeFile *f, const char *path);
+
+/* The i-th column, on the mapped memory (no copy).
+ * The mapping is private: the changes are not written in the file.
+ */
+TypeColumn type_file_column(const TypeFile *f, int i);
+
+void type_file_close(TypeFile *f);
+
+/* Shared stores.
+ * The current value of a set of channels in a file mapped by many
+ * processes (e.g. in /dev/shm): one writer updates the values, the readers
+ * copy them without locks.
+ *
+ * Layout (version 1):
+ *
+ *   header      64 bytes, see TYPE_SHARED_MAGIC
+ *   slots       64 bytes (a cache line) for every channel: a sequence
+ *               counter, type, value and timestamp
+ *
+ * Every slot is a seqlock: the counter is odd while the writer changes the
+ * value, a reader retries until it reads the same even counter before and
+ * after the copy, up to TYPE_SHARED_RETRIES times. The header has the
+ * fingerprint of the configuration, as the column files.
+ *
+ * A writer that dies in the middle of an update leaves the channel busy
+ * (TF_BUSY) for ever: the restarted writer creates the store again and the
+ * readers open the new one.
+ */
+
+#define TYPE_SHARED_MAGIC   "STYPESHM"
+#define TYPE_SHARED_VERSION 1
+
+/* attempts of a reader on a channel, then TF_BUSY */
+#ifndef TYPE_SHARED_RETRIES
+#define TYPE_SHARED_RETRIES 1000
+#endif
+
+/* A shared store mapped in memory, see type_shared_create() */
+struct TypeShared {
+    void *map;
+    size_t size;
+    int channels;
+    int writer;     /* 1 for the store of type_shared_create() */
+};
+
+typedef struct TypeShared TypeShared;
+
+/* Create the store at path, with a channel for every type in types, set
+ * as type_init(). The caller is the writer of the store.
+ * The store is created apart and renamed over path, so the readers of an
+ * old store at path keep it, until they open the new one.
+ */
+enum TypeFileStatus type_shared_create(TypeShared *sh, const char *path,
+                                       const int *types, int channels);
+
+/* Map an existing store for reading.
+ * All the channels are checked on the range of their types (TF_OUTRANGE)
+ * and they must not be busy (TF_BUSY).
+ */
+enum TypeFileStatus type_shared_open(TypeShared *sh, const char *path);
+
+/* Writer only: set the channel with a valid value, see type_valid().
+ * The value must be of the channel type, otherwise TS_INCOMPATIBLE.
+ */
+enum TypeStatus type_shared_put(TypeShared *sh, int ch, const TypeValue tv);
+
+/* Writer only: set the channels from first, as type_shared_put().
+ * The status can be NULL, only the values with TS_OK are written.
+ * Return the number of values not written.
+ */
+int type_shared_put_n(TypeShared *sh, int first, const TypeValue *tv,
+                      const enum TypeStatus *status, int n);
+
+/* A consistent copy of the channel in out.
+ * TF_BUSY if the channel is still in an update after TYPE_SHARED_RETRIES
+ * attempts, out is untouched.
+ */
+enum TypeFileStatus type_shared_get(const TypeShared *sh, int ch,
+                                    TypeValue *out);
+
+/* Copy n channels from first, every one consistent on its own.
+ * The copies are not a snapshot of the whole store at one time.
+ * The status can be NULL.
+ * Return the number of channels TF_BUSY, their out is untouched.
+ */
+int type_shared_get_n(const TypeShared *sh, int first, TypeValue *out,
+                      enum TypeFileStatus *status, int n);
+
+void type_shared_close(TypeShared *sh);